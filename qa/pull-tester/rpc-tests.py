@@ -121,6 +121,8 @@ testScripts = [
     'blockchain.py',
     'disablewallet.py',
     'sendheaders.py', # NOTE: needs x16r_hash to pass
+    'compactblocks.py',
+    'p2p-feefilter.py',
     'keypool.py',
     'keypool-hd.py',
     'prioritise_transaction.py',
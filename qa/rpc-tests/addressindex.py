@@ -105,6 +105,14 @@ class AddressIndexTest(SOVTestFramework):
         assert_equal(multitxids[4], txid2)
         assert_equal(multitxids[5], txidb2)
 
+        # Check that pages of multiple addresses follow the same order
+        multiaddresses = ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB", "yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4"]
+        page = self.nodes[1].getaddresstxids({"addresses": multiaddresses, "limit": 4})
+        assert_equal(page["txids"], multitxids[0:4])
+        page = self.nodes[1].getaddresstxids({"addresses": multiaddresses, "limit": 4, "after": page["next"]})
+        assert_equal(page["txids"], multitxids[4:6])
+        assert_equal(page["next"], None)
+
         # Check that balances are correct
         balance0 = self.nodes[1].getaddressbalance("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
         assert_equal(balance0["balance"], 45 * 100000000)
@@ -129,6 +137,24 @@ class AddressIndexTest(SOVTestFramework):
         assert_equal(len(txidsmany), 4)
         assert_equal(txidsmany[3], sent_txid)
 
+        # Check that txids can be paged through
+        print "Testing paging..."
+        paged = []
+        page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 3})
+        assert_equal(len(page["txids"]), 3)
+        paged += page["txids"]
+        page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 3, "after": page["next"]})
+        assert_equal(page["next"], None)
+        paged += page["txids"]
+        assert_equal(paged, txidsmany)
+
+        # Check that a page token of another address is rejected
+        page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 1})
+        assert_raises(JSONRPCException, self.nodes[1].getaddresstxids,
+                      {"addresses": ["yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4"], "limit": 1, "after": page["next"]})
+        assert_raises(JSONRPCException, self.nodes[1].getaddressdeltas,
+                      {"addresses": ["yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4"], "limit": 1, "after": page["next"]})
+
         # Check that balances are correct
         print "Testing balances..."
         balance0 = self.nodes[1].getaddressbalance("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
@@ -212,6 +238,23 @@ class AddressIndexTest(SOVTestFramework):
         assert_equal(len(utxos2), 1)
         assert_equal(utxos2[0]["satoshis"], amount)
 
+        # Check that the running balances follow the blocks connected and
+        # disconnected again and match the sum of the deltas
+        print "Testing balances across reorgs..."
+        for node in self.nodes:
+            node.reconsiderblock(best_hash)
+        self.sync_all()
+        assert_equal(self.nodes[1].getaddressbalance(address2), balance2)
+        for node in self.nodes:
+            node.invalidateblock(best_hash)
+        self.sync_all()
+        assert_equal(self.nodes[1].getaddressbalance(address2), balance1)
+        for address in [address2, "93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"]:
+            deltas = self.nodes[1].getaddressdeltas({"addresses": [address]})
+            balance = self.nodes[1].getaddressbalance(address)
+            assert_equal(balance["balance"], sum(delta["satoshis"] for delta in deltas))
+            assert_equal(balance["received"], sum(delta["satoshis"] for delta in deltas if delta["satoshis"] > 0))
+
         # Check sorting of utxos
         self.nodes[2].generate(150)
 
@@ -0,0 +1,65 @@
+#!/usr/bin/env python2
+# Copyright (c) 2018 The SOV Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test compact block relay (BIP152) between two nodes and report how long
+# blocks full of mempool transactions take to reach the second node.
+#
+
+from test_framework.test_framework import SOVTestFramework
+from test_framework.util import *
+
+class CompactBlocksTest(SOVTestFramework):
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain(self.options.tmpdir)
+
+    def setup_network(self):
+        args = ["-debug=net"]
+        self.nodes = start_nodes(2, self.options.tmpdir, [args, args])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.is_network_split = False
+        self.sync_all()
+
+    def cmpctblock_bytes(self, node):
+        total = 0
+        for peer in node.getpeerinfo():
+            total += peer["bytesrecv_per_msg"].get("cmpctblock", 0)
+        return total
+
+    def run_test(self):
+        # Leave initial block download on both nodes
+        self.nodes[0].generate(1)
+        self.sync_all()
+
+        address = self.nodes[1].getnewaddress()
+        latencies = []
+        for round in range(5):
+            for i in range(20):
+                self.nodes[0].sendtoaddress(address, Decimal("0.1"))
+            sync_mempools(self.nodes)
+
+            start = time.time()
+            blockhash = self.nodes[0].generate(1)[0]
+            deadline = start + 60
+            while self.nodes[1].getbestblockhash() != blockhash:
+                assert time.time() < deadline, "block %s did not reach node1 within 60s" % blockhash
+                time.sleep(0.01)
+            latencies.append(time.time() - start)
+
+            # All transactions were known, nothing is left behind
+            assert_equal(self.nodes[1].getrawmempool(), [])
+            assert_equal(len(self.nodes[1].getblock(blockhash)["tx"]), 21)
+
+        # Node1 reconstructed the blocks from compact blocks
+        assert(self.cmpctblock_bytes(self.nodes[1]) > 0)
+
+        latencies.sort()
+        print("Block relay latency: min %.3fs median %.3fs max %.3fs" %
+              (latencies[0], latencies[len(latencies) // 2], latencies[-1]))
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
@@ -31,8 +31,12 @@ class ZMQTest (SOVTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        self.zmqRawSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqRawSocket.setsockopt(zmq.SUBSCRIBE, b"rawblock")
+        self.zmqRawSocket.connect("tcp://127.0.0.1:%i" % (self.port + 1))
         return start_nodes(4, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port),
+             '-zmqpubrawblock=tcp://127.0.0.1:'+str(self.port + 1), '-zmqpubrawblockhwm=5000'],
             [],
             [],
             []
@@ -56,6 +60,21 @@ class ZMQTest (SOVTestFramework):
 
         assert_equal(genhashes[0], blkhash) #blockhash from generate must be equal to the hash received over zmq
 
+        # the raw block is published from memory and must match the one stored on disk
+        msg = self.zmqRawSocket.recv_multipart()
+        assert_equal(msg[0], b"rawblock")
+        assert_equal(bytes_to_hex_str(msg[1]), self.nodes[0].getblock(genhashes[0], False))
+
+        notifications = {n["type"]: n for n in self.nodes[0].getzmqnotifications()}
+        assert_equal(sorted(notifications.keys()), ["pubhashblock", "pubhashtx", "pubrawblock"])
+        assert_equal(notifications["pubrawblock"]["address"], "tcp://127.0.0.1:%i" % (self.port + 1))
+        assert_equal(notifications["pubrawblock"]["hwm"], 5000)
+        assert_equal(notifications["pubhashblock"]["hwm"], 1000)
+        assert_equal(notifications["pubrawblock"]["messages"], 1)
+        assert_equal(notifications["pubrawblock"]["bytes"], len(msg[1]))
+        assert_equal(notifications["pubrawblock"]["failures"], 0)
+        assert_equal(self.nodes[1].getzmqnotifications(), [])
+
         n = 10
         genhashes = self.nodes[1].generate(n)
         self.sync_all()
@@ -4,6 +4,7 @@
 
 #include "bench.h"
 
+#include "crypto/x16r.h"
 #include "key.h"
 #include "validation.h"
 #include "util.h"
@@ -13,6 +14,7 @@ main(int argc, char** argv)
 {
     ECC_Start();
     SetupEnvironment();
+    X16RAutoDetect();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
     benchmark::BenchRunner::RunAll();
@@ -0,0 +1,109 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "key.h"
+#include "privatesend.h"
+#include "random.h"
+#include "validation.h"
+#include "wallet/wallet.h"
+
+#include <set>
+#include <vector>
+
+// Listing and selecting coins as done for every send, against a wallet of
+// 500k confirmed outputs of which every tenth is a PrivateSend denomination.
+
+static const unsigned int COIN_SELECTION_BENCH_TXS = 50000;
+static const unsigned int COIN_SELECTION_BENCH_OUTPUTS = 10;
+
+static void FillWallet(CWallet& wallet, CBlockIndex& index, uint256& hashBlock)
+{
+    CPrivateSend::InitStandardDenominations();
+    const std::vector<CAmount>& vecDenoms = CPrivateSend::GetStandardDenominations();
+
+    // a single block all wallet transactions are confirmed in
+    hashBlock = GetRandHash();
+    index.phashBlock = &hashBlock;
+    index.nHeight = 0;
+    {
+        LOCK(cs_main);
+        mapBlockIndex[hashBlock] = &index;
+        chainActive.SetTip(&index);
+    }
+
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    CKey key;
+    key.MakeNewKey(true);
+    assert(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    for (unsigned int i = 0; i < COIN_SELECTION_BENCH_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        tx.vout.resize(COIN_SELECTION_BENCH_OUTPUTS);
+        for (unsigned int j = 0; j < COIN_SELECTION_BENCH_OUTPUTS; j++) {
+            unsigned int n = i * COIN_SELECTION_BENCH_OUTPUTS + j;
+            tx.vout[j].scriptPubKey = scriptPubKey;
+            tx.vout[j].nValue = j == 0 ? vecDenoms[i % vecDenoms.size()] : (n % 97 + 1) * COIN / 10;
+        }
+        CWalletTx wtx(&wallet, tx);
+        wtx.hashBlock = hashBlock;
+        wtx.nIndex = 0;
+        wallet.AddToWallet(wtx, true, NULL);
+    }
+}
+
+static void CleanupWallet(const uint256& hashBlock)
+{
+    LOCK(cs_main);
+    chainActive.SetTip(NULL);
+    mapBlockIndex.erase(hashBlock);
+}
+
+// A regular send: list all coins, then pick inputs for 50 coins.
+static void CoinSelection(benchmark::State& state)
+{
+    CWallet wallet;
+    CBlockIndex index;
+    uint256 hashBlock;
+    FillWallet(wallet, index, hashBlock);
+    wallet.MarkDirty();
+
+    while (state.KeepRunning()) {
+        std::vector<COutput> vCoins;
+        wallet.AvailableCoins(vCoins);
+
+        std::set<std::pair<const CWalletTx*, unsigned int> > setCoins;
+        CAmount nValue;
+        assert(wallet.SelectCoinsMinConf(50 * COIN, 1, 1, vCoins, setCoins, nValue));
+    }
+
+    CleanupWallet(hashBlock);
+}
+
+// Mixing and denominated sends only look at denominated coins.
+static void AvailableDenominatedCoins(benchmark::State& state)
+{
+    CWallet wallet;
+    CBlockIndex index;
+    uint256 hashBlock;
+    FillWallet(wallet, index, hashBlock);
+    wallet.MarkDirty();
+
+    while (state.KeepRunning()) {
+        std::vector<COutput> vCoins;
+        wallet.AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
+        assert(vCoins.size() == COIN_SELECTION_BENCH_TXS);
+    }
+
+    CleanupWallet(hashBlock);
+}
+
+BENCHMARK(CoinSelection);
+BENCHMARK(AvailableDenominatedCoins);
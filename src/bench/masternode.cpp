@@ -0,0 +1,86 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "random.h"
+
+// Rank lookups as done for every InstantSend and payment vote, against a
+// list of 5k masternodes.
+
+static const int MASTERNODE_BENCH_COUNT = 5000;
+
+static void FillMasternodes(CMasternodeMan& mnman, std::vector<COutPoint>& vecOutpoints)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubKey = key.GetPubKey();
+    for (int i = 0; i < MASTERNODE_BENCH_COUNT; i++) {
+        COutPoint outpoint(GetRandHash(), 0);
+        CMasternode mn(CService(), outpoint, pubKey, pubKey, PROTOCOL_VERSION);
+        mn.nCollateralMinConfBlockHash = GetRandHash();
+        mnman.Add(mn);
+        vecOutpoints.push_back(outpoint);
+    }
+}
+
+// Ranks are only computed once the masternode list is synced, pretend it is
+// for the lifetime of a benchmark.
+struct MasternodeListSynced
+{
+    CConnman connman;
+
+    MasternodeListSynced()
+    {
+        while (!masternodeSync.IsMasternodeListSynced())
+            masternodeSync.SwitchToNextAsset(connman);
+    }
+
+    ~MasternodeListSynced()
+    {
+        masternodeSync.Reset();
+    }
+};
+
+// Every lookup for a new block hash, so the rank table is built each time.
+static void MasternodeRankUncached(benchmark::State& state)
+{
+    MasternodeListSynced synced;
+    CMasternodeMan mnman;
+    std::vector<COutPoint> vecOutpoints;
+    FillMasternodes(mnman, vecOutpoints);
+
+    int nRank;
+    unsigned int i = 0;
+    while (state.KeepRunning()) {
+        assert(mnman.GetMasternodeRank(vecOutpoints[i++ % vecOutpoints.size()], nRank, GetRandHash()));
+    }
+}
+
+// Lookups spread over a few recent block hashes, as during a vote flood.
+static void MasternodeRankCached(benchmark::State& state)
+{
+    MasternodeListSynced synced;
+    CMasternodeMan mnman;
+    std::vector<COutPoint> vecOutpoints;
+    FillMasternodes(mnman, vecOutpoints);
+
+    std::vector<uint256> vecBlockHashes;
+    for (int i = 0; i < 4; i++)
+        vecBlockHashes.push_back(GetRandHash());
+
+    int nRank;
+    unsigned int i = 0;
+    while (state.KeepRunning()) {
+        assert(mnman.GetMasternodeRank(vecOutpoints[i % vecOutpoints.size()], nRank, vecBlockHashes[i % vecBlockHashes.size()]));
+        i++;
+    }
+}
+
+BENCHMARK(MasternodeRankUncached);
+BENCHMARK(MasternodeRankCached);
@@ -0,0 +1,173 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "policy/policy.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "version.h"
+
+#include <iostream>
+#include <list>
+#include <map>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+// Mempool lookups as done for every inv, getdata and input check, against a
+// pool of 100k transactions.
+
+static const unsigned int MEMPOOL_BENCH_TXS = 100000;
+
+static void BuildTransactions(std::vector<CTransactionRef>& vtx)
+{
+    for (unsigned int i = 0; i < vtx.size(); i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 1000;
+        tx.vout[1].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        tx.vout[1].nValue = 2000;
+        vtx[i] = MakeTransactionRef(std::move(tx));
+    }
+}
+
+static void AddTx(CTxMemPool& pool, const CTransactionRef& ptx)
+{
+    LockPoints lp;
+    pool.addUnchecked(ptx->GetHash(), CTxMemPoolEntry(ptx, 1000, 0, 0.0, 1, pool.HasNoInputsOf(*ptx), 0, false, 1, lp));
+}
+
+static void FillPool(CTxMemPool& pool, std::vector<CTransactionRef>& vtx)
+{
+    BuildTransactions(vtx);
+    LOCK(pool.cs);
+    for (unsigned int i = 0; i < vtx.size(); i++)
+        AddTx(pool, vtx[i]);
+}
+
+static void MempoolExists(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::vector<CTransactionRef> vtx(MEMPOOL_BENCH_TXS);
+    FillPool(pool, vtx);
+
+    unsigned int i = 0;
+    while (state.KeepRunning()) {
+        const CTransaction& tx = *vtx[i++ % vtx.size()];
+        assert(pool.exists(tx.GetHash()));
+        assert(pool.exists(COutPoint(tx.GetHash(), 1)));
+        assert(!pool.exists(tx.vin[0].prevout.hash));
+    }
+}
+
+static void MempoolSpends(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::vector<CTransactionRef> vtx(MEMPOOL_BENCH_TXS);
+    FillPool(pool, vtx);
+
+    unsigned int i = 0;
+    while (state.KeepRunning()) {
+        const CTransaction& tx = *vtx[i++ % vtx.size()];
+        LOCK(pool.cs);
+        assert(pool.mapNextTx.count(tx.vin[0].prevout));
+        assert(!pool.mapNextTx.count(COutPoint(tx.GetHash(), 0)));
+    }
+}
+
+// One transaction replaced per iteration, keeping the pool at 100k.
+static void MempoolAddRemove(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::vector<CTransactionRef> vtx(MEMPOOL_BENCH_TXS);
+    FillPool(pool, vtx);
+
+    unsigned int i = 0;
+    std::list<CTransaction> removed;
+    while (state.KeepRunning()) {
+        const CTransactionRef& ptx = vtx[i++ % vtx.size()];
+        LOCK(pool.cs);
+        pool.remove(*ptx, removed);
+        AddTx(pool, ptx);
+        removed.clear();
+    }
+}
+
+static void SerializeTransactions(CDataStream& stream, unsigned int nTxs)
+{
+    std::vector<CTransactionRef> vtx(nTxs);
+    BuildTransactions(vtx);
+    for (unsigned int i = 0; i < vtx.size(); i++)
+        stream << *vtx[i];
+}
+
+// Takes nTxs transactions off the wire, accepts them into the pool, keeps them
+// for relay, mines them into a block and removes them again. Returns the pool
+// usage with all of them accepted.
+static size_t FloodPool(CTxMemPool& pool, const CDataStream& stream, unsigned int nTxs, unsigned int nHeight)
+{
+    CDataStream wire(stream.begin(), stream.end(), SER_NETWORK, PROTOCOL_VERSION);
+    std::map<uint256, CTransactionRef> mapRelay;
+    std::list<CTransaction> conflicts;
+    CBlock block;
+    LOCK(pool.cs);
+    for (unsigned int i = 0; i < nTxs; i++) {
+        CTransactionRef ptx;
+        wire >> ptx;
+        AddTx(pool, ptx);
+        mapRelay.insert(std::make_pair(ptx->GetHash(), ptx));
+    }
+    size_t nUsage = pool.DynamicMemoryUsage();
+    for (CTxMemPool::indexed_transaction_set::const_iterator it = pool.mapTx.begin(); it != pool.mapTx.end(); ++it)
+        block.vtx.push_back(it->GetSharedTx());
+    pool.removeForBlock(block.vtx, nHeight, conflicts);
+    return nUsage;
+}
+
+// Transaction flood: each iteration floods the pool with a batch of
+// transactions. The pool, the relay map and the block share one copy of
+// every transaction.
+//
+// Afterwards one flood of 200k transactions is run to report memory: the
+// mempool usage with all of them accepted, and the peak RSS (kB on Linux).
+// The peak RSS is that of the whole bench_sov process, so it also covers the
+// benches run before this one.
+static void MempoolFlood(benchmark::State& state)
+{
+    static const unsigned int FLOOD_BATCH_TXS = 1000;
+    static const unsigned int FLOOD_MEMORY_TXS = 200000;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    SerializeTransactions(stream, FLOOD_BATCH_TXS);
+
+    CTxMemPool pool(CFeeRate(0));
+    unsigned int nHeight = 1;
+    while (state.KeepRunning())
+        FloodPool(pool, stream, FLOOD_BATCH_TXS, nHeight++);
+
+    CDataStream streamMemory(SER_NETWORK, PROTOCOL_VERSION);
+    SerializeTransactions(streamMemory, FLOOD_MEMORY_TXS);
+    size_t nUsage = FloodPool(pool, streamMemory, FLOOD_MEMORY_TXS, nHeight);
+    std::cout << "MempoolFlood memory: " << FLOOD_MEMORY_TXS << " txs, mempool usage " << nUsage << " bytes (" << nUsage / FLOOD_MEMORY_TXS << " per tx)";
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        std::cout << ", peak RSS " << usage.ru_maxrss;
+#endif
+    std::cout << "\n";
+}
+
+BENCHMARK(MempoolExists);
+BENCHMARK(MempoolSpends);
+BENCHMARK(MempoolAddRemove);
+BENCHMARK(MempoolFlood);
@@ -0,0 +1,62 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "pow.h"
+#include "random.h"
+
+// Header acceptance: GetNextWorkRequired() for each header of a chain, in
+// order, as ContextualCheckBlockHeader() does during header sync.
+
+static void BuildChain(std::vector<CBlockIndex>& blocks, std::vector<uint256>& hashes)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        hashes[i] = GetRandHash();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = i ? blocks[i - 1].nTime + params.nPowTargetSpacing / 2 + GetRand(params.nPowTargetSpacing) : 1514764800;
+        blocks[i].nBits = 0x1e0fffff - GetRand(0x0f0000);
+        blocks[i].BuildSkip();
+    }
+}
+
+static void NextWorkRequired(benchmark::State& state, bool fCached)
+{
+    std::vector<CBlockIndex> blocks(2000);
+    std::vector<uint256> hashes(blocks.size());
+    BuildChain(blocks, hashes);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    ClearDifficultyCache();
+    CBlockHeader header;
+    unsigned int i = 0;
+    while (state.KeepRunning()) {
+        if (!fCached)
+            ClearDifficultyCache();
+        GetNextWorkRequired(&blocks[i], &header, params);
+        if (++i == blocks.size())
+            i = 0;
+    }
+}
+
+// Previous behaviour: the whole averaging window walked for every header.
+static void NextWorkRequiredFull(benchmark::State& state)
+{
+    NextWorkRequired(state, false);
+}
+
+static void NextWorkRequiredSliding(benchmark::State& state)
+{
+    NextWorkRequired(state, true);
+}
+
+BENCHMARK(NextWorkRequiredFull);
+BENCHMARK(NextWorkRequiredSliding);
@@ -0,0 +1,77 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "random.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/filesystem.hpp>
+
+// Serving blocks to peers and RPC/REST clients: read the main network genesis block
+// back from a scratch blk00000.dat and take its hash, as ProcessGetData and
+// getblock do.
+
+static void SetupBlockFile(CBlockIndex& index, uint256& hash)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    ClearDatadirCache();
+    boost::filesystem::path pathTemp = GetTempPath() / strprintf("bench_sov_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+
+    const CBlock& genesis = Params().GenesisBlock();
+    CDiskBlockPos pos(0, 0);
+    assert(WriteBlockToDisk(genesis, pos, Params().MessageStart()));
+
+    hash = genesis.GetHash();
+    index = CBlockIndex(genesis.GetBlockHeader());
+    index.phashBlock = &hash;
+    index.nStatus = BLOCK_HAVE_DATA;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+}
+
+static void CleanupBlockFile()
+{
+    boost::filesystem::remove_all(GetDataDir(false));
+    ClearDatadirCache();
+}
+
+// Previous behaviour: proof of work rechecked and the hash recomputed on every read.
+static void ReadBlockFromDiskByPos(benchmark::State& state)
+{
+    CBlockIndex index;
+    uint256 hash;
+    SetupBlockFile(index, hash);
+
+    CBlock block;
+    while (state.KeepRunning()) {
+        assert(ReadBlockFromDisk(block, index.GetBlockPos(), Params().GetConsensus()));
+        assert(block.GetHash() == hash);
+    }
+
+    CleanupBlockFile();
+}
+
+static void ReadBlockFromDiskByIndex(benchmark::State& state)
+{
+    CBlockIndex index;
+    uint256 hash;
+    SetupBlockFile(index, hash);
+
+    CBlock block;
+    while (state.KeepRunning()) {
+        assert(ReadBlockFromDisk(block, &index, Params().GetConsensus()));
+        assert(block.GetHash() == hash);
+    }
+
+    CleanupBlockFile();
+}
+
+BENCHMARK(ReadBlockFromDiskByPos);
+BENCHMARK(ReadBlockFromDiskByIndex);
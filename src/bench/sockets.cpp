@@ -0,0 +1,187 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "compat.h"
+#include "net.h"
+#include "netbase.h"
+#include "protocol.h"
+#include "random.h"
+#include "scheduler.h"
+#include "streams.h"
+#include "util.h"
+#include "version.h"
+
+#ifndef WIN32
+
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// CConnman's socket handler loop with SOCKETS_BENCH_PEERS idle inbound peers
+// connected over loopback, timed on whichever backend was built (epoll on
+// Linux, select() elsewhere). Kept below FD_SETSIZE so select() can take part.
+
+static const int SOCKETS_BENCH_PEERS = 400;
+
+// as in init.cpp
+static const int SOCKETS_BENCH_CORE_FILEDESCRIPTORS = 150;
+
+static bool BenchProcessMessages(CNode* pnode, CConnman& connman, std::atomic<bool>& interrupt)
+{
+    // no peer ever completes a message, keep the message handlers waiting
+    return false;
+}
+
+static bool BenchSendMessages(CNode* pnode, CConnman& connman, std::atomic<bool>& interrupt)
+{
+    return true;
+}
+
+class SocketsBenchSetup
+{
+public:
+    CConnman connman;
+    CScheduler scheduler;
+    std::vector<SOCKET> vClients;
+    unsigned short nPort;
+
+    SocketsBenchSetup()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        ClearDatadirCache();
+        boost::filesystem::path pathTemp = GetTempPath() / strprintf("bench_sov_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        mapArgs["-dnsseed"] = "0";
+        RaiseFileDescriptorLimit(2 * SOCKETS_BENCH_PEERS + SOCKETS_BENCH_CORE_FILEDESCRIPTORS);
+
+        connProcessMessages = GetNodeSignals().ProcessMessages.connect(&BenchProcessMessages);
+        connSendMessages = GetNodeSignals().SendMessages.connect(&BenchSendMessages);
+
+        nPort = FreeLoopbackPort();
+        std::string strError;
+        assert(connman.BindListenPort(CService(LookupNumeric("127.0.0.1", nPort)), strError));
+
+        CConnman::Options options;
+        options.nMaxConnections = SOCKETS_BENCH_PEERS + 16;
+        options.nMaxOutbound = 1;
+        options.nMaxFeeler = 0;
+        options.nSendBufferMaxSize = 1000 * DEFAULT_MAXSENDBUFFER;
+        options.nReceiveFloodSize = 1000 * DEFAULT_MAXRECEIVEBUFFER;
+        assert(connman.Start(scheduler, strError, options));
+
+        for (int i = 0; i < SOCKETS_BENCH_PEERS; i++)
+            vClients.push_back(Connect());
+        WaitForInbound(SOCKETS_BENCH_PEERS);
+    }
+
+    ~SocketsBenchSetup()
+    {
+        for (SOCKET hSocket : vClients)
+            CloseSocket(hSocket);
+        connman.Interrupt();
+        connman.Stop();
+        connProcessMessages.disconnect();
+        connSendMessages.disconnect();
+        boost::filesystem::remove_all(GetDataDir(false));
+        ClearDatadirCache();
+        mapArgs.erase("-dnsseed");
+    }
+
+    SOCKET Connect()
+    {
+        SOCKET hSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        assert(hSocket != INVALID_SOCKET);
+        struct sockaddr_in sockaddr;
+        memset(&sockaddr, 0, sizeof(sockaddr));
+        sockaddr.sin_family = AF_INET;
+        sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sockaddr.sin_port = htons(nPort);
+        int nRet = connect(hSocket, (struct sockaddr*)&sockaddr, sizeof(sockaddr));
+        assert(nRet == 0);
+        return hSocket;
+    }
+
+    void WaitForInbound(size_t nInbound)
+    {
+        while (connman.GetNodeCount(CConnman::CONNECTIONS_IN) != nInbound)
+            std::this_thread::yield();
+    }
+
+    void WaitForBytesRecv(uint64_t nBytesRecv)
+    {
+        while (connman.GetTotalBytesRecv() < nBytesRecv)
+            std::this_thread::yield();
+    }
+
+private:
+    boost::signals2::connection connProcessMessages;
+    boost::signals2::connection connSendMessages;
+
+    static unsigned short FreeLoopbackPort()
+    {
+        SOCKET hSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        assert(hSocket != INVALID_SOCKET);
+        struct sockaddr_in sockaddr;
+        memset(&sockaddr, 0, sizeof(sockaddr));
+        sockaddr.sin_family = AF_INET;
+        sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sockaddr.sin_port = 0;
+        socklen_t len = sizeof(sockaddr);
+        int nRet = bind(hSocket, (struct sockaddr*)&sockaddr, len);
+        assert(nRet == 0);
+        nRet = getsockname(hSocket, (struct sockaddr*)&sockaddr, &len);
+        assert(nRet == 0);
+        CloseSocket(hSocket);
+        return ntohs(sockaddr.sin_port);
+    }
+};
+
+// One more peer sends a byte and the handler wakes up to read it, while the
+// idle peers are waited on as well
+static void SocketHandlerIdlePeers(benchmark::State& state)
+{
+    SocketsBenchSetup setup;
+
+    // the header of the largest message allowed, which never completes, so
+    // the bytes after it are only buffered
+    SOCKET hActive = setup.Connect();
+    setup.WaitForInbound(SOCKETS_BENCH_PEERS + 1);
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << CMessageHeader(Params().MessageStart(), "ping", MAX_PROTOCOL_MESSAGE_LENGTH);
+    uint64_t nBytesRecv = setup.connman.GetTotalBytesRecv() + ssHeader.size();
+    assert(send(hActive, ssHeader.data(), ssHeader.size(), MSG_NOSIGNAL) == (ssize_t)ssHeader.size());
+    setup.WaitForBytesRecv(nBytesRecv);
+
+    char ch = 0;
+    while (state.KeepRunning()) {
+        assert(send(hActive, &ch, 1, MSG_NOSIGNAL) == 1);
+        setup.WaitForBytesRecv(++nBytesRecv);
+    }
+
+    CloseSocket(hActive);
+}
+
+// A peer connecting, being accepted, hanging up and being removed, with the
+// idle peers staying connected
+static void SocketHandlerChurn(benchmark::State& state)
+{
+    SocketsBenchSetup setup;
+
+    while (state.KeepRunning()) {
+        SOCKET hSocket = setup.Connect();
+        setup.WaitForInbound(SOCKETS_BENCH_PEERS + 1);
+        CloseSocket(hSocket);
+        setup.WaitForInbound(SOCKETS_BENCH_PEERS);
+    }
+}
+
+BENCHMARK(SocketHandlerIdlePeers);
+BENCHMARK(SocketHandlerChurn);
+
+#endif // WIN32
@@ -0,0 +1,113 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "primitives/block.h"
+#include "tinyformat.h"
+#include "utiltime.h"
+
+#include <iostream>
+
+// Full X16R chain over an 80-byte header. The previous block hash changes
+// every iteration so that all algorithm orders get exercised.
+static void X16RHeader(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = 1514764800;
+    header.nBits = 0x1e00ffff;
+    uint256 hash;
+    while (state.KeepRunning()) {
+        header.hashPrevBlock = hash;
+        hash = header.GetHash();
+        header.nNonce++;
+    }
+}
+
+// Nonce scan as done by SOVMiner: 256 nonces per iteration from one midstate.
+static void X16RNonceScan(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = 1514764800;
+    header.nBits = 0x1e00ffff;
+    uint32_t vNonce[256];
+    uint256 vHash[256];
+    while (state.KeepRunning()) {
+        header.hashPrevBlock = vHash[255];
+        CX16RMidstate midstate((const unsigned char*)&header.nVersion,
+            (const unsigned char*)&header.nNonce - (const unsigned char*)&header.nVersion, header.hashPrevBlock);
+        for (unsigned int i = 0; i < 256; i++)
+            vNonce[i] = header.nNonce++;
+        midstate.Hash(vNonce, 256, vHash);
+    }
+}
+
+// Single X16R primitive over a 64-byte input, the size hashed by all rounds
+// but the first. Time and hash count are accumulated in algoHashTotal and
+// algoHashHits, indexed like GetHashSelection().
+template<typename Context>
+static void X16RAlgo(benchmark::State& state, int algo, const char* name, const SphHash512& h)
+{
+    static const int BATCH = 64;
+    unsigned char buf[64] = {};
+    Context ctx;
+    while (state.KeepRunning()) {
+        int64_t nStart = GetTimeMicros();
+        for (int i = 0; i < BATCH; i++) {
+            h.Init(&ctx);
+            h.Write(&ctx, buf, sizeof(buf));
+            h.Close(&ctx, buf);
+        }
+        algoHashTotal[algo] += (GetTimeMicros() - nStart) * 0.000001;
+        algoHashHits[algo] += BATCH;
+    }
+    std::cout << strprintf("X16R algo %2d %-10s %.3f us/hash\n", algo, name,
+        algoHashHits[algo] ? algoHashTotal[algo] * 1000000 / algoHashHits[algo] : 0.0);
+}
+
+#define X16R_ALGO_BENCH(algo, name, context, init, write, close) \
+    static void X16R_##algo##_##name(benchmark::State& state) \
+    { \
+        SphHash512 h = { init, write, close }; \
+        X16RAlgo<context>(state, algo, #name, h); \
+    }
+
+X16R_ALGO_BENCH(0, blake, sph_blake512_context, sph_blake512_init, sph_blake512, sph_blake512_close)
+X16R_ALGO_BENCH(1, bmw, sph_bmw512_context, sph_bmw512_init, sph_bmw512, sph_bmw512_close)
+X16R_ALGO_BENCH(2, groestl, sph_groestl512_context, x16rGroestl512.Init, x16rGroestl512.Write, x16rGroestl512.Close)
+X16R_ALGO_BENCH(3, jh, sph_jh512_context, sph_jh512_init, sph_jh512, sph_jh512_close)
+X16R_ALGO_BENCH(4, keccak, sph_keccak512_context, sph_keccak512_init, sph_keccak512, sph_keccak512_close)
+X16R_ALGO_BENCH(5, skein, sph_skein512_context, sph_skein512_init, sph_skein512, sph_skein512_close)
+X16R_ALGO_BENCH(6, luffa, sph_luffa512_context, sph_luffa512_init, sph_luffa512, sph_luffa512_close)
+X16R_ALGO_BENCH(7, cubehash, sph_cubehash512_context, x16rCubehash512.Init, x16rCubehash512.Write, x16rCubehash512.Close)
+X16R_ALGO_BENCH(8, shavite, sph_shavite512_context, x16rShavite512.Init, x16rShavite512.Write, x16rShavite512.Close)
+X16R_ALGO_BENCH(9, simd, sph_simd512_context, sph_simd512_init, sph_simd512, sph_simd512_close)
+X16R_ALGO_BENCH(10, echo, sph_echo512_context, x16rEcho512.Init, x16rEcho512.Write, x16rEcho512.Close)
+X16R_ALGO_BENCH(11, hamsi, sph_hamsi512_context, sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close)
+X16R_ALGO_BENCH(12, fugue, sph_fugue512_context, sph_fugue512_init, sph_fugue512, sph_fugue512_close)
+X16R_ALGO_BENCH(13, shabal, sph_shabal512_context, sph_shabal512_init, sph_shabal512, sph_shabal512_close)
+X16R_ALGO_BENCH(14, whirlpool, sph_whirlpool_context, sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close)
+X16R_ALGO_BENCH(15, sha512, sph_sha512_context, sph_sha512_init, sph_sha512, sph_sha512_close)
+
+BENCHMARK(X16RHeader);
+BENCHMARK(X16RNonceScan);
+BENCHMARK(X16R_0_blake);
+BENCHMARK(X16R_1_bmw);
+BENCHMARK(X16R_2_groestl);
+BENCHMARK(X16R_3_jh);
+BENCHMARK(X16R_4_keccak);
+BENCHMARK(X16R_5_skein);
+BENCHMARK(X16R_6_luffa);
+BENCHMARK(X16R_7_cubehash);
+BENCHMARK(X16R_8_shavite);
+BENCHMARK(X16R_9_simd);
+BENCHMARK(X16R_10_echo);
+BENCHMARK(X16R_11_hamsi);
+BENCHMARK(X16R_12_fugue);
+BENCHMARK(X16R_13_shabal);
+BENCHMARK(X16R_14_whirlpool);
+BENCHMARK(X16R_15_sha512);
@@ -40,7 +40,8 @@ struct CacheItem
 
 
 /**
- * Map like container that keeps the N most recently added items
+ * Map like container that keeps the N most recently added items,
+ * or most recently used ones if lookups are followed by Touch()
  */
 template<typename K, typename V, typename Size = uint32_t>
 class CacheMap
@@ -141,6 +142,16 @@ public:
         return true;
     }
 
+    /// Move an item to the front so that it is pruned last
+    void Touch(const K& key)
+    {
+        map_it it = mapIndex.find(key);
+        if(it == mapIndex.end()) {
+            return;
+        }
+        listItems.splice(listItems.begin(), listItems, it->second);
+    }
+
     void Erase(const K& key)
     {
         map_it it = mapIndex.find(key);
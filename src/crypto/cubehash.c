@@ -134,6 +134,14 @@ static const sph_u32 IV512[] = {
 #define T32      SPH_T32
 #define ROTL32   SPH_ROTL32
 
+/*
+ * The state handling (DECL_STATE, READ_STATE, WRITE_STATE, INPUT_BLOCK,
+ * SIXTEEN_ROUNDS and FINAL_TWEAK) may be predefined by a file which
+ * includes this one to provide a vectorized implementation (see
+ * cubehash_sse2.c).
+ */
+#ifndef DECL_STATE
+
 #if SPH_CUBEHASH_NOCOPY
 
 #define DECL_STATE
@@ -531,6 +539,12 @@ static const sph_u32 IV512[] = {
 
 #endif
 
+#define FINAL_TWEAK   do { \
+		xv ^= SPH_C32(1); \
+	} while (0)
+
+#endif
+
 static void
 cubehash_init(sph_cubehash_context *sc, const sph_u32 *iv)
 {
@@ -595,7 +609,7 @@ cubehash_close(sph_cubehash_context *sc, unsigned ub, unsigned n,
 	for (i = 0; i < 11; i ++) {
 		SIXTEEN_ROUNDS;
 		if (i == 0)
-			xv ^= SPH_C32(1);
+			FINAL_TWEAK;
 	}
 	WRITE_STATE(sc);
 	out = dst;
@@ -0,0 +1,139 @@
+/*
+ * CubeHash implementation using SSE2.
+ *
+ * This compiles cubehash.c a second time, with the 32-word state kept in
+ * eight 128-bit registers and each round done on four words at once, and
+ * with the public functions renamed to sph_cubehash*_sse2*. The two state
+ * halves x[0..15] and x[16..31] are held as a0..a3 and b0..b3. The swaps of
+ * the round become register renaming for the a words and a PSHUFD within
+ * each b register. The output is identical to the portable code. These
+ * functions must only be called on CPUs which support SSE2; use
+ * X16RAutoDetect() (crypto/x16r.cpp) rather than calling them directly.
+ */
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#include <emmintrin.h>
+
+#define sph_cubehash224_init   sph_cubehash224_sse2_init
+#define sph_cubehash224   sph_cubehash224_sse2
+#define sph_cubehash224_close   sph_cubehash224_sse2_close
+#define sph_cubehash224_addbits_and_close   sph_cubehash224_sse2_addbits_and_close
+#define sph_cubehash256_init   sph_cubehash256_sse2_init
+#define sph_cubehash256   sph_cubehash256_sse2
+#define sph_cubehash256_close   sph_cubehash256_sse2_close
+#define sph_cubehash256_addbits_and_close   sph_cubehash256_sse2_addbits_and_close
+#define sph_cubehash384_init   sph_cubehash384_sse2_init
+#define sph_cubehash384   sph_cubehash384_sse2
+#define sph_cubehash384_close   sph_cubehash384_sse2_close
+#define sph_cubehash384_addbits_and_close   sph_cubehash384_sse2_addbits_and_close
+#define sph_cubehash512_init   sph_cubehash512_sse2_init
+#define sph_cubehash512   sph_cubehash512_sse2
+#define sph_cubehash512_close   sph_cubehash512_sse2_close
+#define sph_cubehash512_addbits_and_close   sph_cubehash512_sse2_addbits_and_close
+
+#define DECL_STATE \
+	__m128i a0, a1, a2, a3, b0, b1, b2, b3;
+
+#define READ_STATE(cc)   do { \
+		a0 = _mm_loadu_si128((const __m128i *)((cc)->state +  0)); \
+		a1 = _mm_loadu_si128((const __m128i *)((cc)->state +  4)); \
+		a2 = _mm_loadu_si128((const __m128i *)((cc)->state +  8)); \
+		a3 = _mm_loadu_si128((const __m128i *)((cc)->state + 12)); \
+		b0 = _mm_loadu_si128((const __m128i *)((cc)->state + 16)); \
+		b1 = _mm_loadu_si128((const __m128i *)((cc)->state + 20)); \
+		b2 = _mm_loadu_si128((const __m128i *)((cc)->state + 24)); \
+		b3 = _mm_loadu_si128((const __m128i *)((cc)->state + 28)); \
+	} while (0)
+
+#define WRITE_STATE(cc)   do { \
+		_mm_storeu_si128((__m128i *)((cc)->state +  0), a0); \
+		_mm_storeu_si128((__m128i *)((cc)->state +  4), a1); \
+		_mm_storeu_si128((__m128i *)((cc)->state +  8), a2); \
+		_mm_storeu_si128((__m128i *)((cc)->state + 12), a3); \
+		_mm_storeu_si128((__m128i *)((cc)->state + 16), b0); \
+		_mm_storeu_si128((__m128i *)((cc)->state + 20), b1); \
+		_mm_storeu_si128((__m128i *)((cc)->state + 24), b2); \
+		_mm_storeu_si128((__m128i *)((cc)->state + 28), b3); \
+	} while (0)
+
+/* x86 is little-endian, the block words are loaded as they are */
+#define INPUT_BLOCK   do { \
+		a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i *)(buf +  0))); \
+		a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i *)(buf + 16))); \
+	} while (0)
+
+#define ROTL_SSE2(x, n) \
+	_mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+
+#define ROUND_SSE2   do { \
+		__m128i t; \
+		b0 = _mm_add_epi32(a0, b0); \
+		b1 = _mm_add_epi32(a1, b1); \
+		b2 = _mm_add_epi32(a2, b2); \
+		b3 = _mm_add_epi32(a3, b3); \
+		/* rotate, and swap x[i] with x[i ^ 8] */ \
+		t = ROTL_SSE2(a0, 7); \
+		a0 = ROTL_SSE2(a2, 7); \
+		a2 = t; \
+		t = ROTL_SSE2(a1, 7); \
+		a1 = ROTL_SSE2(a3, 7); \
+		a3 = t; \
+		a0 = _mm_xor_si128(a0, b0); \
+		a1 = _mm_xor_si128(a1, b1); \
+		a2 = _mm_xor_si128(a2, b2); \
+		a3 = _mm_xor_si128(a3, b3); \
+		/* swap x[16 + i] with x[16 + (i ^ 2)] */ \
+		b0 = _mm_shuffle_epi32(b0, _MM_SHUFFLE(1, 0, 3, 2)); \
+		b1 = _mm_shuffle_epi32(b1, _MM_SHUFFLE(1, 0, 3, 2)); \
+		b2 = _mm_shuffle_epi32(b2, _MM_SHUFFLE(1, 0, 3, 2)); \
+		b3 = _mm_shuffle_epi32(b3, _MM_SHUFFLE(1, 0, 3, 2)); \
+		b0 = _mm_add_epi32(a0, b0); \
+		b1 = _mm_add_epi32(a1, b1); \
+		b2 = _mm_add_epi32(a2, b2); \
+		b3 = _mm_add_epi32(a3, b3); \
+		/* rotate, and swap x[i] with x[i ^ 4] */ \
+		t = ROTL_SSE2(a0, 11); \
+		a0 = ROTL_SSE2(a1, 11); \
+		a1 = t; \
+		t = ROTL_SSE2(a2, 11); \
+		a2 = ROTL_SSE2(a3, 11); \
+		a3 = t; \
+		a0 = _mm_xor_si128(a0, b0); \
+		a1 = _mm_xor_si128(a1, b1); \
+		a2 = _mm_xor_si128(a2, b2); \
+		a3 = _mm_xor_si128(a3, b3); \
+		/* swap x[16 + i] with x[16 + (i ^ 1)] */ \
+		b0 = _mm_shuffle_epi32(b0, _MM_SHUFFLE(2, 3, 0, 1)); \
+		b1 = _mm_shuffle_epi32(b1, _MM_SHUFFLE(2, 3, 0, 1)); \
+		b2 = _mm_shuffle_epi32(b2, _MM_SHUFFLE(2, 3, 0, 1)); \
+		b3 = _mm_shuffle_epi32(b3, _MM_SHUFFLE(2, 3, 0, 1)); \
+	} while (0)
+
+#define SIXTEEN_ROUNDS   do { \
+		int j; \
+		for (j = 0; j < 16; j ++) \
+			ROUND_SSE2; \
+	} while (0)
+
+/* x[31] is the last word of b3 */
+#define FINAL_TWEAK   do { \
+		b3 = _mm_xor_si128(b3, _mm_set_epi32(1, 0, 0, 0)); \
+	} while (0)
+
+#include "cubehash.c"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -145,6 +145,11 @@ aes_2rounds_all(sph_u64 W[16][2],
 
 #else
 
+/*
+ * AES_2ROUNDS may be predefined by a file which includes this one to
+ * provide a hardware-accelerated implementation (see echo_aesni.c).
+ */
+#ifndef AES_2ROUNDS
 #define AES_2ROUNDS(X)   do { \
 		sph_u32 X0 = (sph_u32)(X[0]); \
 		sph_u32 X1 = (sph_u32)(X[0] >> 32); \
@@ -161,6 +166,7 @@ aes_2rounds_all(sph_u64 W[16][2],
 					K3 = T32(K3 + 1); \
 		} \
 	} while (0)
+#endif
 
 #define BIG_SUB_WORDS   do { \
 		AES_2ROUNDS(W[ 0]); \
@@ -0,0 +1,68 @@
+/*
+ * ECHO implementation using the AES-NI instructions for the AES rounds.
+ *
+ * This compiles echo.c a second time, with AES_2ROUNDS implemented with
+ * AESENC instead of the table-based AES_ROUND_LE/AES_ROUND_NOKEY_LE
+ * macros from aes_helper.c, and with the public functions renamed to
+ * sph_echo*_aesni*. The output is identical to the portable code. These
+ * functions must only be called on CPUs which support AES-NI; use
+ * X16RAutoDetect() (crypto/x16r.cpp) rather than calling them directly.
+ */
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("aes,sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("aes,sse2")
+#endif
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#define sph_echo224_init   sph_echo224_aesni_init
+#define sph_echo224   sph_echo224_aesni
+#define sph_echo224_close   sph_echo224_aesni_close
+#define sph_echo224_addbits_and_close   sph_echo224_aesni_addbits_and_close
+#define sph_echo256_init   sph_echo256_aesni_init
+#define sph_echo256   sph_echo256_aesni
+#define sph_echo256_close   sph_echo256_aesni_close
+#define sph_echo256_addbits_and_close   sph_echo256_aesni_addbits_and_close
+#define sph_echo384_init   sph_echo384_aesni_init
+#define sph_echo384   sph_echo384_aesni
+#define sph_echo384_close   sph_echo384_aesni_close
+#define sph_echo384_addbits_and_close   sph_echo384_aesni_addbits_and_close
+#define sph_echo512_init   sph_echo512_aesni_init
+#define sph_echo512   sph_echo512_aesni
+#define sph_echo512_close   sph_echo512_aesni_close
+#define sph_echo512_addbits_and_close   sph_echo512_aesni_addbits_and_close
+
+/*
+ * The 64-bit state layout of echo.c keeps each 128-bit word W[n] as two
+ * little-endian 64-bit halves, which is exactly the AES-NI byte order.
+ */
+#define SPH_ECHO_64   1
+
+#define AES_2ROUNDS(X)   do { \
+		__m128i x = _mm_loadu_si128((const __m128i *)(X)); \
+		x = _mm_aesenc_si128(x, _mm_set_epi32( \
+			(int)K3, (int)K2, (int)K1, (int)K0)); \
+		x = _mm_aesenc_si128(x, _mm_setzero_si128()); \
+		_mm_storeu_si128((__m128i *)(X), x); \
+		if ((K0 = T32(K0 + 1)) == 0) { \
+			if ((K1 = T32(K1 + 1)) == 0) \
+				if ((K2 = T32(K2 + 1)) == 0) \
+					K3 = T32(K3 + 1); \
+		} \
+	} while (0)
+
+#include "echo.c"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
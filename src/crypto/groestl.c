@@ -1637,6 +1637,12 @@ static const sph_u64 T7[] = {
 #else
 */
 
+/*
+ * COMPRESS_BIG and FINAL_BIG may be predefined by a file which includes
+ * this one to provide a hardware-accelerated implementation (see
+ * groestl_aesni.c).
+ */
+#ifndef COMPRESS_BIG
 #define COMPRESS_BIG   do { \
 		sph_u64 g[16], m[16]; \
 		size_t u; \
@@ -1650,11 +1656,13 @@ static const sph_u64 T7[] = {
 			H[u] ^= g[u] ^ m[u]; \
 		} \
 	} while (0)
+#endif
 
 /* obsolete
 #endif
 */
 
+#ifndef FINAL_BIG
 #define FINAL_BIG   do { \
 		sph_u64 x[16]; \
 		size_t u; \
@@ -1663,6 +1671,7 @@ static const sph_u64 T7[] = {
 		for (u = 0; u < 16; u ++) \
 			H[u] ^= x[u]; \
 	} while (0)
+#endif
 
 #else
 
@@ -0,0 +1,290 @@
+/*
+ * Groestl implementation using the AES-NI instructions for SubBytes.
+ *
+ * This compiles groestl.c a second time, with COMPRESS_BIG and FINAL_BIG
+ * replaced by a row-oriented version of the 1024-bit P and Q permutations
+ * instead of the T0..T7 table lookups, and with the public functions
+ * renamed to sph_groestl*_aesni*. The output is identical to the portable
+ * code. These functions must only be called on CPUs which support AES-NI
+ * and SSSE3; use X16RAutoDetect() (crypto/x16r.cpp) rather than calling
+ * them directly.
+ *
+ * The 8x16 byte state is kept as one SSE register per row. Groestl uses
+ * the AES S-box, so SubBytes is an AESENCLAST with an all-zero round key,
+ * provided that the AES ShiftRows step it also applies is undone first;
+ * that inverse permutation is folded into the PSHUFB which implements
+ * ShiftBytes. MixBytes multiplies by the circulant matrix
+ * circ(02, 02, 03, 04, 05, 03, 05, 07) over whole rows at once, using
+ * byte-wise doubling in GF(2^8).
+ */
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("aes,ssse3"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("aes,ssse3")
+#endif
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define sph_groestl224_init   sph_groestl224_aesni_init
+#define sph_groestl224   sph_groestl224_aesni
+#define sph_groestl224_close   sph_groestl224_aesni_close
+#define sph_groestl224_addbits_and_close   sph_groestl224_aesni_addbits_and_close
+#define sph_groestl256_init   sph_groestl256_aesni_init
+#define sph_groestl256   sph_groestl256_aesni
+#define sph_groestl256_close   sph_groestl256_aesni_close
+#define sph_groestl256_addbits_and_close   sph_groestl256_aesni_addbits_and_close
+#define sph_groestl384_init   sph_groestl384_aesni_init
+#define sph_groestl384   sph_groestl384_aesni
+#define sph_groestl384_close   sph_groestl384_aesni_close
+#define sph_groestl384_addbits_and_close   sph_groestl384_aesni_addbits_and_close
+#define sph_groestl512_init   sph_groestl512_aesni_init
+#define sph_groestl512   sph_groestl512_aesni
+#define sph_groestl512_close   sph_groestl512_aesni_close
+#define sph_groestl512_addbits_and_close   sph_groestl512_aesni_addbits_and_close
+
+#include "sph_groestl.h"
+
+/*
+ * The big variant keeps each state column as a little-endian 64-bit word,
+ * which is the byte order the transposition below expects.
+ */
+#define SPH_GROESTL_64   1
+
+/*
+ * PSHUFB masks rotating a row left by 0, 1, 2, 3, 4, 5, 6 and 11 bytes
+ * (ShiftBytes), combined with the inverse AES ShiftRows.
+ */
+static const unsigned char groestl_aesni_shift[8][16] = {
+	{ 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3 },
+	{ 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4 },
+	{ 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5 },
+	{ 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6 },
+	{ 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7 },
+	{ 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8 },
+	{ 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9 },
+	{ 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14 }
+};
+
+#define GROESTL_AESNI_MUL2(a)   _mm_xor_si128(_mm_add_epi8(a, a), \
+		_mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), a), \
+			_mm_set1_epi8(0x1B)))
+
+/* ShiftBytes and SubBytes of row i, rotated left by shift number s. */
+#define GROESTL_AESNI_SUB(i, s)   do { \
+		t ## i = _mm_aesenclast_si128(_mm_shuffle_epi8(x ## i, \
+			_mm_loadu_si128((const __m128i *)groestl_aesni_shift[s])), \
+			_mm_setzero_si128()); \
+	} while (0)
+
+/*
+ * Row i of MixBytes is the sum of rows i + k weighted by 02, 02, 03, 04,
+ * 05, 03, 05, 07; this splits it into the rows multiplied by 1 (m1), by
+ * 2 (m2) and by 4 (m4), with u(k) = t(k) ^ t(k + 1).
+ */
+#define GROESTL_AESNI_MIX(i, i1, i2, i3, i4, i5, i6, i7)   do { \
+		__m128i m1, m2, m4; \
+		m4 = _mm_xor_si128(u ## i3, u ## i6); \
+		m2 = _mm_xor_si128(_mm_xor_si128(u ## i, t ## i2), \
+			_mm_xor_si128(t ## i5, t ## i7)); \
+		m1 = _mm_xor_si128(t ## i2, _mm_xor_si128(u ## i4, u ## i6)); \
+		m2 = _mm_xor_si128(m2, GROESTL_AESNI_MUL2(m4)); \
+		x ## i = _mm_xor_si128(m1, GROESTL_AESNI_MUL2(m2)); \
+	} while (0)
+
+#define GROESTL_AESNI_MIX_ALL   do { \
+		u0 = _mm_xor_si128(t0, t1); \
+		u1 = _mm_xor_si128(t1, t2); \
+		u2 = _mm_xor_si128(t2, t3); \
+		u3 = _mm_xor_si128(t3, t4); \
+		u4 = _mm_xor_si128(t4, t5); \
+		u5 = _mm_xor_si128(t5, t6); \
+		u6 = _mm_xor_si128(t6, t7); \
+		u7 = _mm_xor_si128(t7, t0); \
+		GROESTL_AESNI_MIX(0, 1, 2, 3, 4, 5, 6, 7); \
+		GROESTL_AESNI_MIX(1, 2, 3, 4, 5, 6, 7, 0); \
+		GROESTL_AESNI_MIX(2, 3, 4, 5, 6, 7, 0, 1); \
+		GROESTL_AESNI_MIX(3, 4, 5, 6, 7, 0, 1, 2); \
+		GROESTL_AESNI_MIX(4, 5, 6, 7, 0, 1, 2, 3); \
+		GROESTL_AESNI_MIX(5, 6, 7, 0, 1, 2, 3, 4); \
+		GROESTL_AESNI_MIX(6, 7, 0, 1, 2, 3, 4, 5); \
+		GROESTL_AESNI_MIX(7, 0, 1, 2, 3, 4, 5, 6); \
+	} while (0)
+
+#define GROESTL_AESNI_DECL   \
+	__m128i x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3]; \
+	__m128i x4 = x[4], x5 = x[5], x6 = x[6], x7 = x[7]; \
+	__m128i t0, t1, t2, t3, t4, t5, t6, t7; \
+	__m128i u0, u1, u2, u3, u4, u5, u6, u7; \
+	int r
+
+#define GROESTL_AESNI_STORE   do { \
+		x[0] = x0; x[1] = x1; x[2] = x2; x[3] = x3; \
+		x[4] = x4; x[5] = x5; x[6] = x6; x[7] = x7; \
+	} while (0)
+
+static void
+groestl_aesni_perm_p(__m128i x[8])
+{
+	const __m128i pc = _mm_setr_epi8(0x00, 0x10, 0x20, 0x30, 0x40, 0x50,
+		0x60, 0x70, (char)0x80, (char)0x90, (char)0xA0, (char)0xB0,
+		(char)0xC0, (char)0xD0, (char)0xE0, (char)0xF0);
+	GROESTL_AESNI_DECL;
+
+	for (r = 0; r < 14; r ++) {
+		x0 = _mm_xor_si128(x0, _mm_xor_si128(pc, _mm_set1_epi8(r)));
+		GROESTL_AESNI_SUB(0, 0);
+		GROESTL_AESNI_SUB(1, 1);
+		GROESTL_AESNI_SUB(2, 2);
+		GROESTL_AESNI_SUB(3, 3);
+		GROESTL_AESNI_SUB(4, 4);
+		GROESTL_AESNI_SUB(5, 5);
+		GROESTL_AESNI_SUB(6, 6);
+		GROESTL_AESNI_SUB(7, 7);
+		GROESTL_AESNI_MIX_ALL;
+	}
+	GROESTL_AESNI_STORE;
+}
+
+static void
+groestl_aesni_perm_q(__m128i x[8])
+{
+	const __m128i ones = _mm_set1_epi8((char)0xFF);
+	const __m128i qc = _mm_setr_epi8((char)0xFF, (char)0xEF, (char)0xDF,
+		(char)0xCF, (char)0xBF, (char)0xAF, (char)0x9F, (char)0x8F,
+		0x7F, 0x6F, 0x5F, 0x4F, 0x3F, 0x2F, 0x1F, 0x0F);
+	GROESTL_AESNI_DECL;
+
+	for (r = 0; r < 14; r ++) {
+		x0 = _mm_xor_si128(x0, ones);
+		x1 = _mm_xor_si128(x1, ones);
+		x2 = _mm_xor_si128(x2, ones);
+		x3 = _mm_xor_si128(x3, ones);
+		x4 = _mm_xor_si128(x4, ones);
+		x5 = _mm_xor_si128(x5, ones);
+		x6 = _mm_xor_si128(x6, ones);
+		x7 = _mm_xor_si128(x7, _mm_xor_si128(qc, _mm_set1_epi8(r)));
+		GROESTL_AESNI_SUB(0, 1);
+		GROESTL_AESNI_SUB(1, 3);
+		GROESTL_AESNI_SUB(2, 5);
+		GROESTL_AESNI_SUB(3, 7);
+		GROESTL_AESNI_SUB(4, 0);
+		GROESTL_AESNI_SUB(5, 2);
+		GROESTL_AESNI_SUB(6, 4);
+		GROESTL_AESNI_SUB(7, 6);
+		GROESTL_AESNI_MIX_ALL;
+	}
+	GROESTL_AESNI_STORE;
+}
+
+/*
+ * Transpose an 8x8 matrix of 16-bit words. After the byte interleave done
+ * by the callers, word k of row register r holds row r of columns 2k and
+ * 2k + 1, so this turns 16 state columns into 8 state rows and back.
+ */
+static void
+groestl_aesni_transpose(__m128i x[8])
+{
+	__m128i t[8], u[8];
+
+	t[0] = _mm_unpacklo_epi16(x[0], x[1]);
+	t[1] = _mm_unpackhi_epi16(x[0], x[1]);
+	t[2] = _mm_unpacklo_epi16(x[2], x[3]);
+	t[3] = _mm_unpackhi_epi16(x[2], x[3]);
+	t[4] = _mm_unpacklo_epi16(x[4], x[5]);
+	t[5] = _mm_unpackhi_epi16(x[4], x[5]);
+	t[6] = _mm_unpacklo_epi16(x[6], x[7]);
+	t[7] = _mm_unpackhi_epi16(x[6], x[7]);
+	u[0] = _mm_unpacklo_epi32(t[0], t[2]);
+	u[1] = _mm_unpackhi_epi32(t[0], t[2]);
+	u[2] = _mm_unpacklo_epi32(t[1], t[3]);
+	u[3] = _mm_unpackhi_epi32(t[1], t[3]);
+	u[4] = _mm_unpacklo_epi32(t[4], t[6]);
+	u[5] = _mm_unpackhi_epi32(t[4], t[6]);
+	u[6] = _mm_unpacklo_epi32(t[5], t[7]);
+	u[7] = _mm_unpackhi_epi32(t[5], t[7]);
+	x[0] = _mm_unpacklo_epi64(u[0], u[4]);
+	x[1] = _mm_unpackhi_epi64(u[0], u[4]);
+	x[2] = _mm_unpacklo_epi64(u[1], u[5]);
+	x[3] = _mm_unpackhi_epi64(u[1], u[5]);
+	x[4] = _mm_unpacklo_epi64(u[2], u[6]);
+	x[5] = _mm_unpackhi_epi64(u[2], u[6]);
+	x[6] = _mm_unpacklo_epi64(u[3], u[7]);
+	x[7] = _mm_unpackhi_epi64(u[3], u[7]);
+}
+
+/* Load 16 little-endian state columns as 8 rows. */
+static void
+groestl_aesni_to_rows(__m128i x[8], const __m128i *cols)
+{
+	const __m128i interleave = _mm_setr_epi8(
+		0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
+	int i;
+
+	for (i = 0; i < 8; i ++)
+		x[i] = _mm_shuffle_epi8(_mm_loadu_si128(cols + i), interleave);
+	groestl_aesni_transpose(x);
+}
+
+/* XOR 8 state rows into 16 little-endian state columns. */
+static void
+groestl_aesni_xor_cols(__m128i *cols, __m128i x[8])
+{
+	const __m128i deinterleave = _mm_setr_epi8(
+		0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	int i;
+
+	groestl_aesni_transpose(x);
+	for (i = 0; i < 8; i ++)
+		_mm_storeu_si128(cols + i, _mm_xor_si128(
+			_mm_loadu_si128(cols + i),
+			_mm_shuffle_epi8(x[i], deinterleave)));
+}
+
+static void
+groestl_aesni_compress(sph_u64 *H, const unsigned char *buf)
+{
+	__m128i g[8], m[8];
+	sph_u64 hm[16];
+	int i;
+
+	for (i = 0; i < 8; i ++)
+		_mm_storeu_si128((__m128i *)hm + i, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *)H + i),
+			_mm_loadu_si128((const __m128i *)buf + i)));
+	groestl_aesni_to_rows(g, (const __m128i *)hm);
+	groestl_aesni_to_rows(m, (const __m128i *)buf);
+	groestl_aesni_perm_p(g);
+	groestl_aesni_perm_q(m);
+	for (i = 0; i < 8; i ++)
+		g[i] = _mm_xor_si128(g[i], m[i]);
+	groestl_aesni_xor_cols((__m128i *)H, g);
+}
+
+static void
+groestl_aesni_final(sph_u64 *H)
+{
+	__m128i x[8];
+
+	groestl_aesni_to_rows(x, (const __m128i *)H);
+	groestl_aesni_perm_p(x);
+	groestl_aesni_xor_cols((__m128i *)H, x);
+}
+
+#define COMPRESS_BIG   groestl_aesni_compress(H, buf)
+#define FINAL_BIG   groestl_aesni_final(H)
+
+#include "groestl.c"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -88,6 +88,11 @@ static const sph_u32 IV512[] = {
 	C32(0xE275EADE), C32(0x502D9FCD), C32(0xB9357178), C32(0x022A4B9A)
 };
 
+/*
+ * AES_ROUND_NOKEY may be predefined by a file which includes this one to
+ * provide a hardware-accelerated implementation (see shavite_aesni.c).
+ */
+#ifndef AES_ROUND_NOKEY
 #define AES_ROUND_NOKEY(x0, x1, x2, x3)   do { \
 		sph_u32 t0 = (x0); \
 		sph_u32 t1 = (x1); \
@@ -95,6 +100,7 @@ static const sph_u32 IV512[] = {
 		sph_u32 t3 = (x3); \
 		AES_ROUND_NOKEY_LE(t0, t1, t2, t3, x0, x1, x2, x3); \
 	} while (0)
+#endif
 
 /*
  * This is the code needed to match the "reference implementation" as
@@ -0,0 +1,59 @@
+/*
+ * SHAvite-3 implementation using the AES-NI instructions for the AES rounds.
+ *
+ * This compiles shavite.c a second time, with AES_ROUND_NOKEY implemented
+ * with AESENC instead of the table-based AES_ROUND_NOKEY_LE macro from
+ * aes_helper.c, and with the public functions renamed to
+ * sph_shavite*_aesni*. The output is identical to the portable code. These
+ * functions must only be called on CPUs which support AES-NI; use
+ * X16RAutoDetect() (crypto/x16r.cpp) rather than calling them directly.
+ */
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("aes,sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("aes,sse2")
+#endif
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#define sph_shavite224_init   sph_shavite224_aesni_init
+#define sph_shavite224   sph_shavite224_aesni
+#define sph_shavite224_close   sph_shavite224_aesni_close
+#define sph_shavite224_addbits_and_close   sph_shavite224_aesni_addbits_and_close
+#define sph_shavite256_init   sph_shavite256_aesni_init
+#define sph_shavite256   sph_shavite256_aesni
+#define sph_shavite256_close   sph_shavite256_aesni_close
+#define sph_shavite256_addbits_and_close   sph_shavite256_aesni_addbits_and_close
+#define sph_shavite384_init   sph_shavite384_aesni_init
+#define sph_shavite384   sph_shavite384_aesni
+#define sph_shavite384_close   sph_shavite384_aesni_close
+#define sph_shavite384_addbits_and_close   sph_shavite384_aesni_addbits_and_close
+#define sph_shavite512_init   sph_shavite512_aesni_init
+#define sph_shavite512   sph_shavite512_aesni
+#define sph_shavite512_close   sph_shavite512_aesni_close
+#define sph_shavite512_addbits_and_close   sph_shavite512_aesni_addbits_and_close
+
+#define AES_ROUND_NOKEY(x0, x1, x2, x3)   do { \
+		__m128i t = _mm_set_epi32( \
+			(int)(x3), (int)(x2), (int)(x1), (int)(x0)); \
+		t = _mm_aesenc_si128(t, _mm_setzero_si128()); \
+		(x0) = (sph_u32)_mm_cvtsi128_si32(t); \
+		(x1) = (sph_u32)_mm_cvtsi128_si32(_mm_srli_si128(t, 4)); \
+		(x2) = (sph_u32)_mm_cvtsi128_si32(_mm_srli_si128(t, 8)); \
+		(x3) = (sph_u32)_mm_cvtsi128_si32(_mm_srli_si128(t, 12)); \
+	} while (0)
+
+#include "shavite.c"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -285,6 +285,18 @@ void sph_cubehash512_close(void *cc, void *dst);
  */
 void sph_cubehash512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+#if defined(__x86_64__) || defined(__amd64__)
+/*
+ * CubeHash-512 functions using SSE2 (cubehash_sse2.c). They use the same
+ * context structure and give the same output as the functions above, and
+ * must only be called on CPUs which support SSE2.
+ */
+void sph_cubehash512_sse2_init(void *cc);
+void sph_cubehash512_sse2(void *cc, const void *data, size_t len);
+void sph_cubehash512_sse2_close(void *cc, void *dst);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -306,6 +306,17 @@ void sph_shavite512_close(void *cc, void *dst);
  */
 void sph_shavite512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+#if defined(__x86_64__) || defined(__amd64__)
+/*
+ * SHAvite-512 functions using AES-NI (shavite_aesni.c). They use the same context
+ * structure and give the same output as the functions above, and must
+ * only be called on CPUs which support AES-NI.
+ */
+void sph_shavite512_aesni_init(void *cc);
+void sph_shavite512_aesni(void *cc, const void *data, size_t len);
+void sph_shavite512_aesni_close(void *cc, void *dst);
+#endif
 	
 #ifdef __cplusplus
 }
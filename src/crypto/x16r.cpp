@@ -0,0 +1,98 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/x16r.h"
+
+#include "crypto/sph_cubehash.h"
+#include "crypto/sph_echo.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_shavite.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__)
+#include <cpuid.h>
+#endif
+
+namespace
+{
+const SphHash512 groestl512Standard = { sph_groestl512_init, sph_groestl512, sph_groestl512_close };
+const SphHash512 shavite512Standard = { sph_shavite512_init, sph_shavite512, sph_shavite512_close };
+const SphHash512 echo512Standard = { sph_echo512_init, sph_echo512, sph_echo512_close };
+const SphHash512 cubehash512Standard = { sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close };
+
+/** Check that an implementation matches the reference one for a range of message lengths
+ *  (within one block, exactly one block, and spanning several blocks). */
+template<typename Context>
+bool SelfTest(const SphHash512& reference, const SphHash512& impl)
+{
+    unsigned char in[300];
+    for (unsigned int i = 0; i < sizeof(in); i++)
+        in[i] = (unsigned char)(i * 7 + 3);
+
+    static const size_t lengths[] = {0, 1, 64, 80, 127, 128, 129, 300};
+    for (size_t len : lengths) {
+        Context ctx;
+        unsigned char out1[64], out2[64];
+        reference.Init(&ctx);
+        reference.Write(&ctx, in, len);
+        reference.Close(&ctx, out1);
+        impl.Init(&ctx);
+        impl.Write(&ctx, in, len);
+        impl.Close(&ctx, out2);
+        if (memcmp(out1, out2, sizeof(out1)))
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+SphHash512 x16rGroestl512 = groestl512Standard;
+SphHash512 x16rShavite512 = shavite512Standard;
+SphHash512 x16rEcho512 = echo512Standard;
+SphHash512 x16rCubehash512 = cubehash512Standard;
+
+std::string X16RAutoDetect()
+{
+    std::string ret;
+#if defined(__x86_64__) || defined(__amd64__)
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx >> 26) & 1) {
+        SphHash512 cubehash = { sph_cubehash512_sse2_init, sph_cubehash512_sse2, sph_cubehash512_sse2_close };
+        assert(SelfTest<sph_cubehash512_context>(cubehash512Standard, cubehash));
+        x16rCubehash512 = cubehash;
+        ret = "sse2(cubehash)";
+    } else {
+        x16rCubehash512 = cubehash512Standard;
+    }
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 25) & 1) {
+        // groestl_aesni.c also needs SSSE3 for PSHUFB
+        bool fSSSE3 = (ecx >> 9) & 1;
+        SphHash512 groestl = { sph_groestl512_aesni_init, sph_groestl512_aesni, sph_groestl512_aesni_close };
+        SphHash512 shavite = { sph_shavite512_aesni_init, sph_shavite512_aesni, sph_shavite512_aesni_close };
+        SphHash512 echo = { sph_echo512_aesni_init, sph_echo512_aesni, sph_echo512_aesni_close };
+        ret += ret.empty() ? "aesni(" : ",aesni(";
+        if (fSSSE3) {
+            assert(SelfTest<sph_groestl512_context>(groestl512Standard, groestl));
+            x16rGroestl512 = groestl;
+            ret += "groestl,";
+        } else {
+            x16rGroestl512 = groestl512Standard;
+        }
+        assert(SelfTest<sph_shavite512_context>(shavite512Standard, shavite));
+        assert(SelfTest<sph_echo512_context>(echo512Standard, echo));
+        x16rShavite512 = shavite;
+        x16rEcho512 = echo;
+        return ret + "shavite,echo)";
+    }
+#else
+    x16rCubehash512 = cubehash512Standard;
+#endif
+    x16rGroestl512 = groestl512Standard;
+    x16rShavite512 = shavite512Standard;
+    x16rEcho512 = echo512Standard;
+    return ret.empty() ? "standard" : ret;
+}
+
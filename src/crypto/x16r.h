@@ -0,0 +1,46 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SOV_CRYPTO_X16R_H
+#define SOV_CRYPTO_X16R_H
+
+#include <stddef.h>
+#include <string>
+
+/** Entry points of one sph-style 512-bit hash primitive used by X16R. */
+struct SphHash512
+{
+    void (*Init)(void* cc);
+    void (*Write)(void* cc, const void* data, size_t len);
+    void (*Close)(void* cc, void* dst);
+};
+
+/** X16R primitives which have more than one implementation. They default to
+ *  the portable sph code until X16RAutoDetect() has been called.
+ *
+ *  Only these have a faster backend: Groestl, SHAvite and ECHO on AES-NI,
+ *  and CubeHash on SSE2, whose ARX round maps directly onto four-word
+ *  vectors. The others stay portable, each for its own reason:
+ *  - Fugue: its SMIX can take the S-box from AESENCLAST, but the 16x16
+ *    super-mix after it has no AES counterpart and needs its own kernel.
+ *  - SIMD, Luffa and Hamsi: vectorizing them is a rewrite of the
+ *    algorithm, not of the round macros, so the sph code cannot be reused
+ *    the way the other backends reuse it.
+ *  - BLAKE, BMW, Skein and Keccak: their 64-bit scalar code is already
+ *    close to what two-lane SSE2 gives.
+ *  - AVX2: its gains come from hashing several messages at once, one per
+ *    lane. HashX16R hashes a single header, and the swaps of a one-message
+ *    CubeHash round would cross the 128-bit lanes. */
+extern SphHash512 x16rGroestl512;
+extern SphHash512 x16rShavite512;
+extern SphHash512 x16rEcho512;
+extern SphHash512 x16rCubehash512;
+
+/** Select the fastest X16R primitive implementations supported by this CPU,
+ *  after checking that they give the same results as the portable code.
+ *  Returns a description of the selected implementation, naming the
+ *  primitives which are accelerated. */
+std::string X16RAutoDetect();
+
+#endif // SOV_CRYPTO_X16R_H
@@ -140,6 +140,17 @@ public:
         piter->Seek(slKey);
     }
 
+    /** Position at the first entry after key, to resume an iteration that last returned key */
+    template<typename K> void SeekAfter(const K& key) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey << key;
+        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        piter->Seek(slKey);
+        if (piter->Valid() && piter->key() == slKey)
+            piter->Next();
+    }
+
     void Next();
 
     template<typename K> bool GetKey(K& key) {
@@ -303,6 +314,24 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /** Iterator over the state of the database at the time of psnapshot */
+    CDBIterator *NewIterator(const leveldb::Snapshot *psnapshot)
+    {
+        leveldb::ReadOptions snapshotoptions = iteroptions;
+        snapshotoptions.snapshot = psnapshot;
+        return new CDBIterator(*this, pdb->NewIterator(snapshotoptions));
+    }
+
+    const leveldb::Snapshot *GetSnapshot()
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot *psnapshot)
+    {
+        pdb->ReleaseSnapshot(psnapshot);
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -342,4 +371,21 @@ public:
 
 };
 
+/** Holds a snapshot of a CDBWrapper, so that several iterators see the same state */
+class CDBSnapshot
+{
+private:
+    CDBWrapper &parent;
+    const leveldb::Snapshot *psnapshot;
+
+    CDBSnapshot(const CDBSnapshot&);
+    void operator=(const CDBSnapshot&);
+
+public:
+    explicit CDBSnapshot(CDBWrapper &parentIn) : parent(parentIn), psnapshot(parentIn.GetSnapshot()) {}
+    ~CDBSnapshot() { parent.ReleaseSnapshot(psnapshot); }
+
+    CDBIterator *NewIterator() const { return parent.NewIterator(psnapshot); }
+};
+
 #endif // SOV_DBWRAPPER_H
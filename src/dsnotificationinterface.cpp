@@ -58,3 +58,19 @@ void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBl
     instantsend.SyncTransaction(tx, pblock);
     CPrivateSend::SyncTransaction(tx, pblock);
 }
+
+void CDSNotificationInterface::BlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    if (fLiteMode)
+        return;
+
+    mnpaidindex.BlockConnected(block, pindex);
+}
+
+void CDSNotificationInterface::BlockDisconnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    if (fLiteMode)
+        return;
+
+    mnpaidindex.BlockDisconnected(block, pindex);
+}
@@ -14,6 +14,7 @@ using namespace std;
 
 class CGovernanceVote;
 class CConnman;
+class CHashSignerCheck;
 
 // INTENTION OF MASTERNODES REGARDING ITEM
 enum vote_outcome_enum_t  {
@@ -121,6 +122,9 @@ public:
 
     void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
 
+    std::string GetSignatureMessage() const;
+    CHashSignerCheck GetSignatureCheck() const;
+
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(bool fSignatureCheck) const;
     void Relay(CConnman& connman) const;
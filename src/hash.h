@@ -12,6 +12,7 @@
 #include <chrono>
 #include "crypto/ripemd160.h"
 #include "crypto/sha256.h"
+#include "crypto/x16r.h"
 #include "prevector.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -381,34 +382,103 @@ extern double algoHashTotal[16];
 extern int algoHashHits[16];
 
 /* ----------- X16r Hash ------------------------------------------------ */
+
+/** State of any one of the sixteen X16R primitives. */
+union X16RContext
+{
+    sph_blake512_context     blake;      //0
+    sph_bmw512_context       bmw;        //1
+    sph_groestl512_context   groestl;    //2
+    sph_jh512_context        jh;         //3
+    sph_keccak512_context    keccak;     //4
+    sph_skein512_context     skein;      //5
+    sph_luffa512_context     luffa;      //6
+    sph_cubehash512_context  cubehash;   //7
+    sph_shavite512_context   shavite;    //8
+    sph_simd512_context      simd;       //9
+    sph_echo512_context      echo;       //A
+    sph_hamsi512_context     hamsi;      //B
+    sph_fugue512_context     fugue;      //C
+    sph_shabal512_context    shabal;     //D
+    sph_whirlpool_context    whirlpool;  //E
+    sph_sha512_context       sha512;     //F
+};
+
+inline void X16RInit(int hashSelection, X16RContext& ctx)
+{
+    switch(hashSelection) {
+        case 0:  sph_blake512_init(&ctx.blake); break;
+        case 1:  sph_bmw512_init(&ctx.bmw); break;
+        case 2:  x16rGroestl512.Init(&ctx.groestl); break;
+        case 3:  sph_jh512_init(&ctx.jh); break;
+        case 4:  sph_keccak512_init(&ctx.keccak); break;
+        case 5:  sph_skein512_init(&ctx.skein); break;
+        case 6:  sph_luffa512_init(&ctx.luffa); break;
+        case 7:  x16rCubehash512.Init(&ctx.cubehash); break;
+        case 8:  x16rShavite512.Init(&ctx.shavite); break;
+        case 9:  sph_simd512_init(&ctx.simd); break;
+        case 10: x16rEcho512.Init(&ctx.echo); break;
+        case 11: sph_hamsi512_init(&ctx.hamsi); break;
+        case 12: sph_fugue512_init(&ctx.fugue); break;
+        case 13: sph_shabal512_init(&ctx.shabal); break;
+        case 14: sph_whirlpool_init(&ctx.whirlpool); break;
+        case 15: sph_sha512_init(&ctx.sha512); break;
+    }
+}
+
+inline void X16RWrite(int hashSelection, X16RContext& ctx, const void* data, size_t len)
+{
+    switch(hashSelection) {
+        case 0:  sph_blake512(&ctx.blake, data, len); break;
+        case 1:  sph_bmw512(&ctx.bmw, data, len); break;
+        case 2:  x16rGroestl512.Write(&ctx.groestl, data, len); break;
+        case 3:  sph_jh512(&ctx.jh, data, len); break;
+        case 4:  sph_keccak512(&ctx.keccak, data, len); break;
+        case 5:  sph_skein512(&ctx.skein, data, len); break;
+        case 6:  sph_luffa512(&ctx.luffa, data, len); break;
+        case 7:  x16rCubehash512.Write(&ctx.cubehash, data, len); break;
+        case 8:  x16rShavite512.Write(&ctx.shavite, data, len); break;
+        case 9:  sph_simd512(&ctx.simd, data, len); break;
+        case 10: x16rEcho512.Write(&ctx.echo, data, len); break;
+        case 11: sph_hamsi512(&ctx.hamsi, data, len); break;
+        case 12: sph_fugue512(&ctx.fugue, data, len); break;
+        case 13: sph_shabal512(&ctx.shabal, data, len); break;
+        case 14: sph_whirlpool(&ctx.whirlpool, data, len); break;
+        case 15: sph_sha512(&ctx.sha512, data, len); break;
+    }
+}
+
+inline void X16RClose(int hashSelection, X16RContext& ctx, void* dst)
+{
+    switch(hashSelection) {
+        case 0:  sph_blake512_close(&ctx.blake, dst); break;
+        case 1:  sph_bmw512_close(&ctx.bmw, dst); break;
+        case 2:  x16rGroestl512.Close(&ctx.groestl, dst); break;
+        case 3:  sph_jh512_close(&ctx.jh, dst); break;
+        case 4:  sph_keccak512_close(&ctx.keccak, dst); break;
+        case 5:  sph_skein512_close(&ctx.skein, dst); break;
+        case 6:  sph_luffa512_close(&ctx.luffa, dst); break;
+        case 7:  x16rCubehash512.Close(&ctx.cubehash, dst); break;
+        case 8:  x16rShavite512.Close(&ctx.shavite, dst); break;
+        case 9:  sph_simd512_close(&ctx.simd, dst); break;
+        case 10: x16rEcho512.Close(&ctx.echo, dst); break;
+        case 11: sph_hamsi512_close(&ctx.hamsi, dst); break;
+        case 12: sph_fugue512_close(&ctx.fugue, dst); break;
+        case 13: sph_shabal512_close(&ctx.shabal, dst); break;
+        case 14: sph_whirlpool_close(&ctx.whirlpool, dst); break;
+        case 15: sph_sha512_close(&ctx.sha512, dst); break;
+    }
+}
+
 template<typename T1>
 inline uint256 HashX16R(const T1 pbegin, const T1 pend, const uint256 PrevBlockHash)
 {
-//	static std::chrono::duration<double>[16];
-    int hashSelection;
-
-    sph_blake512_context     ctx_blake;      //0
-    sph_bmw512_context       ctx_bmw;        //1
-    sph_groestl512_context   ctx_groestl;    //2
-    sph_jh512_context        ctx_jh;         //3
-    sph_keccak512_context    ctx_keccak;     //4
-    sph_skein512_context     ctx_skein;      //5
-    sph_luffa512_context     ctx_luffa;      //6
-    sph_cubehash512_context  ctx_cubehash;   //7
-    sph_shavite512_context   ctx_shavite;    //8
-    sph_simd512_context      ctx_simd;       //9
-    sph_echo512_context      ctx_echo;       //A
-    sph_hamsi512_context     ctx_hamsi;      //B
-    sph_fugue512_context     ctx_fugue;      //C
-    sph_shabal512_context    ctx_shabal;     //D
-    sph_whirlpool_context    ctx_whirlpool;  //E
-    sph_sha512_context       ctx_sha512;     //F
-
     static unsigned char pblank[1];
 
+    X16RContext ctx;
     uint512 hash[16];
 
-    for (int i=0;i<16;i++) 
+    for (int i=0;i<16;i++)
     {
         const void *toHash;
         int lenToHash;
@@ -420,93 +490,69 @@ inline uint256 HashX16R(const T1 pbegin, const T1 pend, const uint256 PrevBlockH
             lenToHash = 64;
         }
 
-        hashSelection = GetHashSelection(PrevBlockHash, i);
-
-        switch(hashSelection) {
-            case 0:
-                sph_blake512_init(&ctx_blake);
-                sph_blake512 (&ctx_blake, toHash, lenToHash);
-                sph_blake512_close(&ctx_blake, static_cast<void*>(&hash[i]));
-                break;
-            case 1:
-                sph_bmw512_init(&ctx_bmw);
-                sph_bmw512 (&ctx_bmw, toHash, lenToHash);
-                sph_bmw512_close(&ctx_bmw, static_cast<void*>(&hash[i]));
-                break;
-            case 2:
-                sph_groestl512_init(&ctx_groestl);
-                sph_groestl512 (&ctx_groestl, toHash, lenToHash);
-                sph_groestl512_close(&ctx_groestl, static_cast<void*>(&hash[i]));
-                break;
-            case 3:
-                sph_jh512_init(&ctx_jh);
-                sph_jh512 (&ctx_jh, toHash, lenToHash);
-                sph_jh512_close(&ctx_jh, static_cast<void*>(&hash[i]));
-                break;
-            case 4:
-                sph_keccak512_init(&ctx_keccak);
-                sph_keccak512 (&ctx_keccak, toHash, lenToHash);
-                sph_keccak512_close(&ctx_keccak, static_cast<void*>(&hash[i]));
-                break;
-            case 5:
-                sph_skein512_init(&ctx_skein);
-                sph_skein512 (&ctx_skein, toHash, lenToHash);
-                sph_skein512_close(&ctx_skein, static_cast<void*>(&hash[i]));
-                break;
-            case 6:
-                sph_luffa512_init(&ctx_luffa);
-                sph_luffa512 (&ctx_luffa, toHash, lenToHash);
-                sph_luffa512_close(&ctx_luffa, static_cast<void*>(&hash[i]));
-                break;
-            case 7:
-                sph_cubehash512_init(&ctx_cubehash);
-                sph_cubehash512 (&ctx_cubehash, toHash, lenToHash);
-                sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash[i]));
-                break;
-            case 8:
-                sph_shavite512_init(&ctx_shavite);
-                sph_shavite512(&ctx_shavite, toHash, lenToHash);
-                sph_shavite512_close(&ctx_shavite, static_cast<void*>(&hash[i]));
-                break;
-            case 9:
-                sph_simd512_init(&ctx_simd);
-                sph_simd512 (&ctx_simd, toHash, lenToHash);
-                sph_simd512_close(&ctx_simd, static_cast<void*>(&hash[i]));
-                break;
-            case 10:
-                sph_echo512_init(&ctx_echo);
-                sph_echo512 (&ctx_echo, toHash, lenToHash);
-                sph_echo512_close(&ctx_echo, static_cast<void*>(&hash[i]));
-                break;
-           case 11:
-                sph_hamsi512_init(&ctx_hamsi);
-                sph_hamsi512 (&ctx_hamsi, toHash, lenToHash);
-                sph_hamsi512_close(&ctx_hamsi, static_cast<void*>(&hash[i]));
-                break;
-           case 12:
-                sph_fugue512_init(&ctx_fugue);
-                sph_fugue512 (&ctx_fugue, toHash, lenToHash);
-                sph_fugue512_close(&ctx_fugue, static_cast<void*>(&hash[i]));
-                break;
-           case 13:
-                sph_shabal512_init(&ctx_shabal);
-                sph_shabal512 (&ctx_shabal, toHash, lenToHash);
-                sph_shabal512_close(&ctx_shabal, static_cast<void*>(&hash[i]));
-                break;
-           case 14:
-                sph_whirlpool_init(&ctx_whirlpool);
-                sph_whirlpool(&ctx_whirlpool, toHash, lenToHash);
-                sph_whirlpool_close(&ctx_whirlpool, static_cast<void*>(&hash[i]));
-                break;
-           case 15:
-                sph_sha512_init(&ctx_sha512);
-                sph_sha512 (&ctx_sha512, toHash, lenToHash);
-                sph_sha512_close(&ctx_sha512, static_cast<void*>(&hash[i]));
-                break;
-        }
+        int hashSelection = GetHashSelection(PrevBlockHash, i);
+        X16RInit(hashSelection, ctx);
+        X16RWrite(hashSelection, ctx, toHash, lenToHash);
+        X16RClose(hashSelection, ctx, static_cast<void*>(&hash[i]));
     }
 
     return hash[15].trim256();
 }
 
+/** X16R of many inputs that share a common prefix and previous block hash, and
+ *  differ only in a 4-byte suffix: the nonce at the end of an 80-byte header
+ *  while mining. The first-round state after the prefix is computed once and
+ *  copied for each nonce, and a batch is pushed through all sixteen rounds one
+ *  round at a time, since every input uses the same algorithm order.
+ */
+class CX16RMidstate
+{
+private:
+    uint256 hashPrevBlock;
+    int nFirstSelection;
+    X16RContext ctxPrefix;
+    std::vector<uint512> vHash;
+
+public:
+    CX16RMidstate() : nFirstSelection(-1) {}
+
+    CX16RMidstate(const unsigned char* pprefix, size_t nPrefixLen, const uint256& hashPrevBlockIn)
+    {
+        Reset(pprefix, nPrefixLen, hashPrevBlockIn);
+    }
+
+    /** Start over with a new prefix, keeping the allocated scratch space. */
+    void Reset(const unsigned char* pprefix, size_t nPrefixLen, const uint256& hashPrevBlockIn)
+    {
+        hashPrevBlock = hashPrevBlockIn;
+        nFirstSelection = GetHashSelection(hashPrevBlock, 0);
+        X16RInit(nFirstSelection, ctxPrefix);
+        X16RWrite(nFirstSelection, ctxPrefix, pprefix, nPrefixLen);
+    }
+
+    /** Hash prefix || nonce for each of nCount nonces. The nonces are appended in
+     *  host byte order, as they are laid out in a CBlockHeader. */
+    void Hash(const uint32_t* pnonces, size_t nCount, uint256* phashes)
+    {
+        assert(nFirstSelection >= 0);
+        vHash.resize(nCount);
+        X16RContext ctx;
+        for (size_t n = 0; n < nCount; n++) {
+            ctx = ctxPrefix;
+            X16RWrite(nFirstSelection, ctx, &pnonces[n], sizeof(pnonces[n]));
+            X16RClose(nFirstSelection, ctx, static_cast<void*>(&vHash[n]));
+        }
+        for (int i = 1; i < 16; i++) {
+            int hashSelection = GetHashSelection(hashPrevBlock, i);
+            for (size_t n = 0; n < nCount; n++) {
+                X16RInit(hashSelection, ctx);
+                X16RWrite(hashSelection, ctx, static_cast<const void*>(&vHash[n]), 64);
+                X16RClose(hashSelection, ctx, static_cast<void*>(&vHash[n]));
+            }
+        }
+        for (size_t n = 0; n < nCount; n++)
+            phashes[n] = vHash[n].trim256();
+    }
+};
+
 #endif // SOV_HASH_H
@@ -13,6 +13,7 @@ class COutPointLock;
 class CTxLockRequest;
 class CTxLockCandidate;
 class CInstantSend;
+class CHashSignerCheck;
 
 extern CInstantSend instantsend;
 
@@ -94,6 +95,8 @@ public:
     void RejectLockRequest(const CTxLockRequest& txLockRequest);
     bool HasTxLockRequest(const uint256& txHash);
     bool GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLockRequestRet);
+    // transactions of all lock candidates, for compact block reconstruction
+    void GetLockCandidateTransactions(std::vector<CTransactionRef>& vtxRet);
 
     bool GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet);
 
@@ -116,10 +119,15 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
 
+    // lock all inputs of the request without any votes, needed for unit testing
+    void ForceTransactionLockForTesting(const CTxLockRequest& txLockRequest);
+    // forget all lock requests, votes and locks, needed for unit testing
+    void ClearForTesting();
+
     std::string ToString();
 };
 
-class CTxLockRequest : public CTransaction
+class CTxLockRequest
 {
 private:
     static const CAmount MIN_FEE            = 0.0001 * COIN;
@@ -127,16 +135,29 @@ private:
 public:
     static const int WARN_MANY_INPUTS       = 100;
 
-    CTxLockRequest() = default;
-    CTxLockRequest(const CTransaction& tx) : CTransaction(tx) {};
+    // shared with the mempool and the lock candidate, never copied
+    CTransactionRef tx;
+
+    CTxLockRequest() : tx(MakeTransactionRef()) {};
+    CTxLockRequest(const CTransaction& _tx) : tx(MakeTransactionRef(_tx)) {};
+    CTxLockRequest(const CTransactionRef& _tx) : tx(_tx) {};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(tx);
+    }
 
     bool IsValid() const;
     CAmount GetMinFee() const;
     int GetMaxSignatures() const;
 
+    const uint256& GetHash() const { return tx->GetHash(); }
+
     explicit operator bool() const
     {
-        return *this != CTxLockRequest();
+        return *tx != CTransaction();
     }
 };
 
@@ -192,6 +213,9 @@ public:
     bool IsTimedOut() const;
     bool IsFailed() const;
 
+    std::string GetSignatureMessage() const;
+    CHashSignerCheck GetSignatureCheck() const;
+
     bool Sign();
     bool CheckSignature() const;
 
@@ -16,6 +16,8 @@
 
 /** Object for who's going to get paid on which blocks */
 CMasternodePayments mnpayments;
+/** Object for when each payee was last paid */
+CMasternodePaidIndex mnpaidindex;
 
 CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapMasternodeBlocks;
@@ -36,8 +38,8 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
 {
     strErrorRet = "";
 
-    bool isBlockRewardValueMet = (block.vtx[0].GetValueOut() <= blockReward);
-    if(fDebug) LogPrintf("block.vtx[0].GetValueOut() %lld <= blockReward %lld\n", block.vtx[0].GetValueOut(), blockReward);
+    bool isBlockRewardValueMet = (block.vtx[0]->GetValueOut() <= blockReward);
+    if(fDebug) LogPrintf("block.vtx[0].GetValueOut() %lld <= blockReward %lld\n", block.vtx[0]->GetValueOut(), blockReward);
 
     // we are still using budgets, but we have no data about them anymore,
     // all we know is predefined budget cycle and window
@@ -54,7 +56,7 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
                 LogPrint("gobject", "IsBlockValueValid -- Client synced but budget spork is disabled, checking block value against block reward\n");
                 if(!isBlockRewardValueMet) {
                     strErrorRet = strprintf("coinbase pays too much at height %d (actual=%d vs limit=%d), exceeded block reward, budgets are disabled",
-                                            nBlockHeight, block.vtx[0].GetValueOut(), blockReward);
+                                            nBlockHeight, block.vtx[0]->GetValueOut(), blockReward);
                 }
                 return isBlockRewardValueMet;
             }
@@ -65,7 +67,7 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
         // LogPrint("gobject", "IsBlockValueValid -- Block is not in budget cycle window, checking block value against block reward\n");
         if(!isBlockRewardValueMet) {
             strErrorRet = strprintf("coinbase pays too much at height %d (actual=%d vs limit=%d), exceeded block reward, block is not in budget cycle window",
-                                    nBlockHeight, block.vtx[0].GetValueOut(), blockReward);
+                                    nBlockHeight, block.vtx[0]->GetValueOut(), blockReward);
         }
         return isBlockRewardValueMet;
     }
@@ -73,9 +75,9 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
     // superblocks started
 
     CAmount nSuperblockMaxValue =  blockReward + CSuperblock::GetPaymentsLimit(nBlockHeight);
-    bool isSuperblockMaxValueMet = (block.vtx[0].GetValueOut() <= nSuperblockMaxValue);
+    bool isSuperblockMaxValueMet = (block.vtx[0]->GetValueOut() <= nSuperblockMaxValue);
 
-    LogPrint("gobject", "block.vtx[0].GetValueOut() %lld <= nSuperblockMaxValue %lld\n", block.vtx[0].GetValueOut(), nSuperblockMaxValue);
+    LogPrint("gobject", "block.vtx[0].GetValueOut() %lld <= nSuperblockMaxValue %lld\n", block.vtx[0]->GetValueOut(), nSuperblockMaxValue);
 
     if(!masternodeSync.IsSynced()) {
         // not enough data but at least it must NOT exceed superblock max value
@@ -83,13 +85,13 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
             if(fDebug) LogPrintf("IsBlockPayeeValid -- WARNING: Client not synced, checking superblock max bounds only\n");
             if(!isSuperblockMaxValueMet) {
                 strErrorRet = strprintf("coinbase pays too much at height %d (actual=%d vs limit=%d), exceeded superblock max value",
-                                        nBlockHeight, block.vtx[0].GetValueOut(), nSuperblockMaxValue);
+                                        nBlockHeight, block.vtx[0]->GetValueOut(), nSuperblockMaxValue);
             }
             return isSuperblockMaxValueMet;
         }
         if(!isBlockRewardValueMet) {
             strErrorRet = strprintf("coinbase pays too much at height %d (actual=%d vs limit=%d), exceeded block reward, only regular blocks are allowed at this height",
-                                    nBlockHeight, block.vtx[0].GetValueOut(), blockReward);
+                                    nBlockHeight, block.vtx[0]->GetValueOut(), blockReward);
         }
         // it MUST be a regular block otherwise
         return isBlockRewardValueMet;
@@ -99,14 +101,14 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
 
     if(sporkManager.IsSporkActive(SPORK_9_SUPERBLOCKS_ENABLED)) {
         if(CSuperblockManager::IsSuperblockTriggered(nBlockHeight)) {
-            if(CSuperblockManager::IsValid(block.vtx[0], nBlockHeight, blockReward)) {
-                LogPrint("gobject", "IsBlockValueValid -- Valid superblock at height %d: %s", nBlockHeight, block.vtx[0].ToString());
+            if(CSuperblockManager::IsValid(*block.vtx[0], nBlockHeight, blockReward)) {
+                LogPrint("gobject", "IsBlockValueValid -- Valid superblock at height %d: %s", nBlockHeight, block.vtx[0]->ToString());
                 // all checks are done in CSuperblock::IsValid, nothing to do here
                 return true;
             }
 
             // triggered but invalid? that's weird
-            LogPrintf("IsBlockValueValid -- ERROR: Invalid superblock detected at height %d: %s", nBlockHeight, block.vtx[0].ToString());
+            LogPrintf("IsBlockValueValid -- ERROR: Invalid superblock detected at height %d: %s", nBlockHeight, block.vtx[0]->ToString());
             // should NOT allow invalid superblocks, when superblocks are enabled
             strErrorRet = strprintf("invalid superblock detected at height %d", nBlockHeight);
             return false;
@@ -114,14 +116,14 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
         LogPrint("gobject", "IsBlockValueValid -- No triggered superblock detected at height %d\n", nBlockHeight);
         if(!isBlockRewardValueMet) {
             strErrorRet = strprintf("coinbase pays too much at height %d (actual=%d vs limit=%d), exceeded block reward, no triggered superblock detected",
-                                    nBlockHeight, block.vtx[0].GetValueOut(), blockReward);
+                                    nBlockHeight, block.vtx[0]->GetValueOut(), blockReward);
         }
     } else {
         // should NOT allow superblocks at all, when superblocks are disabled
         LogPrint("gobject", "IsBlockValueValid -- Superblocks are disabled, no superblocks allowed\n");
         if(!isBlockRewardValueMet) {
             strErrorRet = strprintf("coinbase pays too much at height %d (actual=%d vs limit=%d), exceeded block reward, superblocks are disabled",
-                                    nBlockHeight, block.vtx[0].GetValueOut(), blockReward);
+                                    nBlockHeight, block.vtx[0]->GetValueOut(), blockReward);
         }
     }
 
@@ -415,12 +417,22 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
     }
 }
 
+std::string CMasternodePaymentVote::GetSignatureMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() +
+            boost::lexical_cast<std::string>(nBlockHeight) +
+            ScriptToAsmStr(payee);
+}
+
+CHashSignerCheck CMasternodePaymentVote::GetSignatureCheck() const
+{
+    return CHashSignerCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), vchSig);
+}
+
 bool CMasternodePaymentVote::Sign()
 {
     std::string strError;
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                boost::lexical_cast<std::string>(nBlockHeight) +
-                ScriptToAsmStr(payee);
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, activeMasternode.keyMasternode)) {
         LogPrintf("CMasternodePaymentVote::Sign -- SignMessage() failed\n");
@@ -446,24 +458,21 @@ bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 
 // Is this masternode scheduled to get paid soon?
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 blocks of votes
-bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
+void CMasternodePayments::GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if(!masternodeSync.IsMasternodeListSynced()) return false;
+    setPayeesRet.clear();
 
-    CScript mnpayee;
-    mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+    if(!masternodeSync.IsMasternodeListSynced()) return;
 
     CScript payee;
     for(int64_t h = nCachedBlockHeight; h <= nCachedBlockHeight + 8; h++){
         if(h == nNotBlockHeight) continue;
-        if(mapMasternodeBlocks.count(h) && mapMasternodeBlocks[h].GetBestPayee(payee) && mnpayee == payee) {
-            return true;
+        if(mapMasternodeBlocks.count(h) && mapMasternodeBlocks[h].GetBestPayee(payee)) {
+            setPayeesRet.insert(payee);
         }
     }
-
-    return false;
 }
 
 bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
@@ -473,16 +482,22 @@ bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
 
     if(HasVerifiedPaymentVote(vote.GetHash())) return false;
 
-    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+    {
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+
+        mapMasternodePaymentVotes[vote.GetHash()] = vote;
 
-    mapMasternodePaymentVotes[vote.GetHash()] = vote;
+        if(!mapMasternodeBlocks.count(vote.nBlockHeight)) {
+           CMasternodeBlockPayees blockPayees(vote.nBlockHeight);
+           mapMasternodeBlocks[vote.nBlockHeight] = blockPayees;
+        }
 
-    if(!mapMasternodeBlocks.count(vote.nBlockHeight)) {
-       CMasternodeBlockPayees blockPayees(vote.nBlockHeight);
-       mapMasternodeBlocks[vote.nBlockHeight] = blockPayees;
+        mapMasternodeBlocks[vote.nBlockHeight].AddPayee(vote);
     }
 
-    mapMasternodeBlocks[vote.nBlockHeight].AddPayee(vote);
+    // the block this vote is for may already be connected, e.g. while catching up
+    // before the winners list is synced, let the paid index count it now
+    mnpaidindex.PaymentVoteAdded(vote.nBlockHeight);
 
     return true;
 }
@@ -494,6 +509,16 @@ bool CMasternodePayments::HasVerifiedPaymentVote(uint256 hashIn)
     return it != mapMasternodePaymentVotes.end() && it->second.IsVerified();
 }
 
+bool CMasternodePayments::GetVerifiedPaymentVote(const uint256& hashIn, CMasternodePaymentVote& voteRet)
+{
+    LOCK(cs_mapMasternodePaymentVotes);
+    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.find(hashIn);
+    if (it == mapMasternodePaymentVotes.end() || !it->second.IsVerified())
+        return false;
+    voteRet = it->second;
+    return true;
+}
+
 void CMasternodeBlockPayees::AddPayee(const CMasternodePaymentVote& vote)
 {
     LOCK(cs_vecPayees);
@@ -855,9 +880,7 @@ bool CMasternodePaymentVote::CheckSignature(const CPubKey& pubKeyMasternode, int
     // do not ban by default
     nDos = 0;
 
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                boost::lexical_cast<std::string>(nBlockHeight) +
-                ScriptToAsmStr(payee);
+    std::string strMessage = GetSignatureMessage();
 
     std::string strError = "";
     if (!CMessageSigner::VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
@@ -1025,3 +1048,228 @@ void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& c
     CheckPreviousBlockVotes(nFutureBlock - 1);
     ProcessBlock(nFutureBlock, connman);
 }
+
+const std::string CMasternodePaidIndex::SERIALIZATION_VERSION_STRING = "CMasternodePaidIndex-Version-2";
+
+void CMasternodePaidIndex::Clear()
+{
+    LOCK(cs);
+    hashBestBlock.SetNull();
+    mapLastPaid.clear();
+    mapPaidBlocks.clear();
+    mapUnvotedBlocks.clear();
+}
+
+void CMasternodePaidIndex::AddPayment(const CScript& payee, int nHeight, int64_t nTime)
+{
+    AssertLockHeld(cs);
+
+    std::vector<CScript>& vecPayees = mapPaidBlocks[nHeight].second;
+    mapPaidBlocks[nHeight].first = nTime;
+    vecPayees.push_back(payee);
+
+    // a payment counted late can be older than the one already known
+    std::map<CScript, std::pair<int, int64_t> >::iterator itLast = mapLastPaid.find(payee);
+    if(itLast == mapLastPaid.end() || itLast->second.first < nHeight) {
+        mapLastPaid[payee] = std::make_pair(nHeight, nTime);
+    }
+}
+
+void CMasternodePaidIndex::ForgetBlocksBelow(std::map<int, std::pair<int64_t, std::vector<CScript> > >& mapBlocks, int nHeight, bool fLastPaid)
+{
+    AssertLockHeld(cs);
+
+    std::map<int, std::pair<int64_t, std::vector<CScript> > >::iterator it = mapBlocks.begin();
+    while(it != mapBlocks.end() && it->first < nHeight) {
+        if(fLastPaid) {
+            BOOST_FOREACH(const CScript& payee, it->second.second) {
+                std::map<CScript, std::pair<int, int64_t> >::iterator itLast = mapLastPaid.find(payee);
+                if(itLast != mapLastPaid.end() && itLast->second.first == it->first) {
+                    mapLastPaid.erase(itLast);
+                }
+            }
+        }
+        mapBlocks.erase(it++);
+    }
+}
+
+void CMasternodePaidIndex::ConnectPayments(const CBlock& block, const CBlockIndex* pindex, int nLimit)
+{
+    AssertLockHeld(cs);
+
+    hashBestBlock = pindex->GetBlockHash();
+
+    const CTransaction& txCoinbase = *block.vtx[0];
+    CAmount nMasternodePayment = GetMasternodePayment(pindex->nHeight, txCoinbase.GetValueOut());
+
+    if(nMasternodePayment > 0) {
+        // only count payments to payees which were also voted for, like the old block scan did
+        // payments without enough votes yet are kept aside and counted by
+        // PaymentVoteAdded() once the votes arrive
+        LOCK(cs_mapMasternodeBlocks);
+        std::map<int, CMasternodeBlockPayees>::iterator itPayees = mnpayments.mapMasternodeBlocks.find(pindex->nHeight);
+        BOOST_FOREACH(const CTxOut& txout, txCoinbase.vout) {
+            if(txout.nValue != nMasternodePayment) continue;
+            if(itPayees == mnpayments.mapMasternodeBlocks.end() || !itPayees->second.HasPayeeWithVotes(txout.scriptPubKey, 2)) {
+                mapUnvotedBlocks[pindex->nHeight].first = pindex->nTime;
+                mapUnvotedBlocks[pindex->nHeight].second.push_back(txout.scriptPubKey);
+                continue;
+            }
+            AddPayment(txout.scriptPubKey, pindex->nHeight, pindex->nTime);
+        }
+    }
+
+    // forget payments which are too old to be scanned for anyway
+    ForgetBlocksBelow(mapPaidBlocks, pindex->nHeight - nLimit + 1, true);
+    ForgetBlocksBelow(mapUnvotedBlocks, pindex->nHeight - nLimit + 1, false);
+}
+
+bool CMasternodePaidIndex::SyncToTip(const CBlockIndex* pindexTip)
+{
+    AssertLockHeld(cs_main);
+
+    if(!pindexTip) return true;
+
+    int nLimit = mnpayments.GetStorageLimit();
+
+    LOCK(cs);
+
+    // resume from the block we were synced to if it is still in the chain,
+    // start over if it was reorged away or is out of the payment window
+    int nStartHeight = std::max(0, pindexTip->nHeight - nLimit + 1);
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashBestBlock);
+    if(mi != mapBlockIndex.end() && pindexTip->GetAncestor(mi->second->nHeight) == mi->second &&
+        mi->second->nHeight >= nStartHeight - 1) {
+        nStartHeight = mi->second->nHeight + 1;
+    } else {
+        Clear();
+    }
+
+    if(nStartHeight <= pindexTip->nHeight) {
+        LogPrintf("CMasternodePaidIndex::SyncToTip -- reading blocks %d-%d\n", nStartHeight, pindexTip->nHeight);
+    }
+
+    for(int nHeight = nStartHeight; nHeight <= pindexTip->nHeight; nHeight++) {
+        const CBlockIndex* pindex = pindexTip->GetAncestor(nHeight);
+        CBlock block;
+        if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            // pruned, nothing to learn from this block
+            hashBestBlock = pindex->GetBlockHash();
+            continue;
+        }
+        ConnectPayments(block, pindex, nLimit);
+    }
+
+    // votes loaded from mnpayments.dat never went through AddPaymentVote()
+    std::vector<int> vecUnvotedHeights;
+    for(const auto& blockpair : mapUnvotedBlocks) {
+        vecUnvotedHeights.push_back(blockpair.first);
+    }
+    BOOST_FOREACH(int nHeight, vecUnvotedHeights) {
+        PaymentVoteAdded(nHeight);
+    }
+
+    return true;
+}
+
+void CMasternodePaidIndex::BlockConnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+
+    // GetStorageLimit() locks mnodeman which is taken before cs in UpdateLastPaid
+    int nLimit = mnpayments.GetStorageLimit();
+
+    bool fSynced;
+    {
+        LOCK(cs);
+        fSynced = pindex->pprev && hashBestBlock == pindex->pprev->GetBlockHash();
+    }
+    if(!fSynced) {
+        SyncToTip(pindex->pprev);
+    }
+
+    LOCK(cs);
+    ConnectPayments(block, pindex, nLimit);
+}
+
+void CMasternodePaidIndex::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+
+    // an index which is behind will be resynced by the next BlockConnected
+    if(hashBestBlock != pindex->GetBlockHash()) return;
+
+    hashBestBlock = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+
+    mapUnvotedBlocks.erase(pindex->nHeight);
+
+    std::map<int, std::pair<int64_t, std::vector<CScript> > >::iterator it = mapPaidBlocks.find(pindex->nHeight);
+    if(it == mapPaidBlocks.end()) return;
+
+    std::vector<CScript> vecPayees = it->second.second;
+    mapPaidBlocks.erase(it);
+
+    BOOST_FOREACH(const CScript& payee, vecPayees) {
+        std::map<CScript, std::pair<int, int64_t> >::iterator itLast = mapLastPaid.find(payee);
+        if(itLast == mapLastPaid.end() || itLast->second.first != pindex->nHeight) continue;
+        mapLastPaid.erase(itLast);
+        // fall back to the previous payment still in the window, if any
+        std::map<int, std::pair<int64_t, std::vector<CScript> > >::reverse_iterator rit = mapPaidBlocks.rbegin();
+        for(; rit != mapPaidBlocks.rend(); ++rit) {
+            const std::vector<CScript>& vecBlockPayees = rit->second.second;
+            if(std::find(vecBlockPayees.begin(), vecBlockPayees.end(), payee) != vecBlockPayees.end()) {
+                mapLastPaid[payee] = std::make_pair(rit->first, rit->second.first);
+                break;
+            }
+        }
+    }
+}
+
+void CMasternodePaidIndex::PaymentVoteAdded(int nBlockHeight)
+{
+    LOCK(cs);
+
+    std::map<int, std::pair<int64_t, std::vector<CScript> > >::iterator it = mapUnvotedBlocks.find(nBlockHeight);
+    if(it == mapUnvotedBlocks.end()) return;
+
+    LOCK(cs_mapMasternodeBlocks);
+    std::map<int, CMasternodeBlockPayees>::iterator itPayees = mnpayments.mapMasternodeBlocks.find(nBlockHeight);
+    if(itPayees == mnpayments.mapMasternodeBlocks.end()) return;
+
+    std::vector<CScript>& vecPayees = it->second.second;
+    std::vector<CScript>::iterator itPayee = vecPayees.begin();
+    while(itPayee != vecPayees.end()) {
+        if(!itPayees->second.HasPayeeWithVotes(*itPayee, 2)) {
+            ++itPayee;
+            continue;
+        }
+        LogPrint("mnpayments", "CMasternodePaidIndex::PaymentVoteAdded -- counting payment at height %d\n", nBlockHeight);
+        AddPayment(*itPayee, nBlockHeight, it->second.first);
+        itPayee = vecPayees.erase(itPayee);
+    }
+    if(vecPayees.empty()) {
+        mapUnvotedBlocks.erase(it);
+    }
+}
+
+bool CMasternodePaidIndex::GetLastPaid(const CScript& payee, int& nHeightRet, int64_t& nTimeRet) const
+{
+    LOCK(cs);
+    std::map<CScript, std::pair<int, int64_t> >::const_iterator it = mapLastPaid.find(payee);
+    if(it == mapLastPaid.end()) return false;
+    nHeightRet = it->second.first;
+    nTimeRet = it->second.second;
+    return true;
+}
+
+std::string CMasternodePaidIndex::ToString() const
+{
+    LOCK(cs);
+    std::ostringstream info;
+
+    info << "Payees: " << (int)mapLastPaid.size() <<
+            ", Blocks: " << (int)mapPaidBlocks.size() <<
+            ", Unvoted blocks: " << (int)mapUnvotedBlocks.size();
+
+    return info.str();
+}
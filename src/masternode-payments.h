@@ -12,9 +12,11 @@
 #include "net_processing.h"
 #include "utilstrencodings.h"
 
+class CMasternodePaidIndex;
 class CMasternodePayments;
 class CMasternodePaymentVote;
 class CMasternodeBlockPayees;
+class CHashSignerCheck;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
@@ -29,8 +31,10 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_2 = 70208;
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
 extern CCriticalSection cs_mapMasternodePayeeVotes;
+extern CCriticalSection cs_mapMasternodePaymentVotes;
 
 extern CMasternodePayments mnpayments;
+extern CMasternodePaidIndex mnpaidindex;
 
 /// TODO: all 4 functions do not belong here really, they should be refactored/moved somewhere (main.cpp ?)
 bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string &strErrorRet);
@@ -147,6 +151,9 @@ public:
         return ss.GetHash();
     }
 
+    std::string GetSignatureMessage() const;
+    CHashSignerCheck GetSignatureCheck() const;
+
     bool Sign();
     bool CheckSignature(const CPubKey& pubKeyMasternode, int nValidationHeight, int &nDos);
 
@@ -195,6 +202,7 @@ public:
 
     bool AddPaymentVote(const CMasternodePaymentVote& vote);
     bool HasVerifiedPaymentVote(uint256 hashIn);
+    bool GetVerifiedPaymentVote(const uint256& hashIn, CMasternodePaymentVote& voteRet);
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
     void CheckPreviousBlockVotes(int nPrevBlockHeight);
 
@@ -204,7 +212,8 @@ public:
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
-    bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
+    /// Payees which are already winners of one of the next 8 blocks, except nNotBlockHeight
+    void GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet);
 
     bool CanVote(COutPoint outMasternode, int nBlockHeight);
 
@@ -223,4 +232,127 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex, CConnman& connman);
 };
 
+// A single masternode payment as stored in mnpaid.dat
+class CMasternodePaidEntry
+{
+public:
+    CScript scriptPubKey;
+    int nBlockHeight;
+    int64_t nTime;
+
+    CMasternodePaidEntry() : scriptPubKey(), nBlockHeight(0), nTime(0) {}
+    CMasternodePaidEntry(const CScript& scriptPubKeyIn, int nBlockHeightIn, int64_t nTimeIn) :
+        scriptPubKey(scriptPubKeyIn), nBlockHeight(nBlockHeightIn), nTime(nTimeIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(*(CScriptBase*)(&scriptPubKey));
+        READWRITE(nBlockHeight);
+        READWRITE(nTime);
+    }
+};
+
+//
+// Masternode Paid Index Class
+// Keeps track of the last block each payee script was paid a masternode reward in,
+// updated from the coinbase of every connected or disconnected block
+//
+
+class CMasternodePaidIndex
+{
+private:
+    static const std::string SERIALIZATION_VERSION_STRING;
+
+    mutable CCriticalSection cs;
+
+    // block the index is synced to
+    uint256 hashBestBlock;
+    // payee script -> height and time of its latest payment
+    std::map<CScript, std::pair<int, int64_t> > mapLastPaid;
+    // height -> block time and payees paid in that block, kept for
+    // GetStorageLimit() blocks so that disconnected blocks can be undone
+    std::map<int, std::pair<int64_t, std::vector<CScript> > > mapPaidBlocks;
+    // height -> block time and payees paid in that block which did not have
+    // enough votes yet when it was connected, same window as mapPaidBlocks
+    std::map<int, std::pair<int64_t, std::vector<CScript> > > mapUnvotedBlocks;
+
+    void AddPayment(const CScript& payee, int nHeight, int64_t nTime);
+    void ForgetBlocksBelow(std::map<int, std::pair<int64_t, std::vector<CScript> > >& mapBlocks, int nHeight, bool fLastPaid);
+    void ConnectPayments(const CBlock& block, const CBlockIndex* pindex, int nLimit);
+
+public:
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        LOCK(cs);
+        std::string strVersion;
+        if(ser_action.ForRead()) {
+            READWRITE(strVersion);
+        }
+        else {
+            strVersion = SERIALIZATION_VERSION_STRING;
+            READWRITE(strVersion);
+        }
+
+        // mapLastPaid only ever points into mapPaidBlocks, store the payments once
+        std::vector<CMasternodePaidEntry> vecPayments;
+        std::vector<CMasternodePaidEntry> vecUnvotedPayments;
+        if(!ser_action.ForRead()) {
+            for(const auto& blockpair : mapPaidBlocks) {
+                for(const auto& payee : blockpair.second.second) {
+                    vecPayments.push_back(CMasternodePaidEntry(payee, blockpair.first, blockpair.second.first));
+                }
+            }
+            for(const auto& blockpair : mapUnvotedBlocks) {
+                for(const auto& payee : blockpair.second.second) {
+                    vecUnvotedPayments.push_back(CMasternodePaidEntry(payee, blockpair.first, blockpair.second.first));
+                }
+            }
+        }
+
+        READWRITE(hashBestBlock);
+        READWRITE(vecPayments);
+        READWRITE(vecUnvotedPayments);
+
+        if(ser_action.ForRead()) {
+            mapLastPaid.clear();
+            mapPaidBlocks.clear();
+            mapUnvotedBlocks.clear();
+            for(const auto& payment : vecPayments) {
+                std::pair<int64_t, std::vector<CScript> >& block = mapPaidBlocks[payment.nBlockHeight];
+                block.first = payment.nTime;
+                block.second.push_back(payment.scriptPubKey);
+                // payments are stored in height order
+                mapLastPaid[payment.scriptPubKey] = std::make_pair(payment.nBlockHeight, payment.nTime);
+            }
+            for(const auto& payment : vecUnvotedPayments) {
+                std::pair<int64_t, std::vector<CScript> >& block = mapUnvotedBlocks[payment.nBlockHeight];
+                block.first = payment.nTime;
+                block.second.push_back(payment.scriptPubKey);
+            }
+            if(strVersion != SERIALIZATION_VERSION_STRING) {
+                Clear();
+            }
+        }
+    }
+
+    void Clear();
+    /// This is dummy overload to be used for dumping/loading mnpaid.dat
+    void CheckAndRemove() {}
+
+    /// Bring the index up to pindexTip after loading, reading only the blocks it is missing
+    bool SyncToTip(const CBlockIndex* pindexTip);
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+    /// Count payments at nBlockHeight which were connected before they had enough votes
+    void PaymentVoteAdded(int nBlockHeight);
+
+    bool GetLastPaid(const CScript& payee, int& nHeightRet, int64_t& nTimeRet) const;
+
+    std::string ToString() const;
+};
+
 #endif
@@ -21,15 +21,6 @@ CMasternodeMan mnodeman;
 
 const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-7";
 
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, CMasternode*>& t1,
-                    const std::pair<int, CMasternode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
-
 struct CompareScoreMN
 {
     bool operator()(const std::pair<arith_uint256, CMasternode*>& t1,
@@ -62,6 +53,11 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesAdded(false),
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
+  setPaymentQueue(),
+  mapPaymentQueueLastPaid(),
+  mapCollateralHeight(),
+  pindexCollateralHeightTip(NULL),
+  mapRankTables(RANK_TABLE_CACHE_SIZE),
   nLastWatchdogVoteTime(0),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
@@ -76,6 +72,8 @@ bool CMasternodeMan::Add(CMasternode &mn)
 
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.vin.prevout] = mn;
+    UpdatePaymentQueue(mn);
+    mapRankTables.Clear();
     fMasternodesAdded = true;
     return true;
 }
@@ -189,6 +187,8 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                RemoveFromPaymentQueue(it->first);
+                mapRankTables.Clear();
                 mapMasternodes.erase(it++);
                 fMasternodesRemoved = true;
             } else {
@@ -350,6 +350,10 @@ void CMasternodeMan::Clear()
     mWeAskedForMasternodeListEntry.clear();
     mapSeenMasternodeBroadcast.clear();
     mapSeenMasternodePing.clear();
+    setPaymentQueue.clear();
+    mapPaymentQueueLastPaid.clear();
+    mapCollateralHeight.clear();
+    mapRankTables.Clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
 }
@@ -503,41 +507,60 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
     // Need LOCK2 here to ensure consistent locking order because the GetBlockHash call below locks cs_main
     LOCK2(cs_main,cs);
 
-    std::vector<std::pair<int, CMasternode*> > vecMasternodeLastPaid;
+    int nMnCount = CountMasternodes();
+    int nMinProtocol = mnpayments.GetMinMasternodePaymentsProto();
+
+    // payees in the list (up to 8 entries ahead of current block to allow propagation) are skipped
+    std::set<CScript> setScheduledPayees;
+    mnpayments.GetScheduledPayees(nBlockHeight, setScheduledPayees);
+
+    if(setPaymentQueue.size() != mapMasternodes.size()) {
+        RebuildPaymentQueue();
+    }
 
     /*
-        Make a vector with all of the last paid times
+        Walk the masternodes from the oldest payment on, keeping the first tenth which qualify
     */
 
-    int nMnCount = CountMasternodes();
+    int nTenthNetwork = std::max(nMnCount/10, 1);
+    std::vector<CMasternode*> vecOldest;
 
-    for (auto& mnpair : mapMasternodes) {
-        if(!mnpair.second.IsValidForPayment()) continue;
+    for (const auto& queuepair : setPaymentQueue) {
+        std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.find(queuepair.second);
+        if(it == mapMasternodes.end() || it->second.GetLastPaidBlock() != queuepair.first) {
+            // an entry was changed behind our back, restore the order and start over
+            LogPrint("masternode", "CMasternodeMan::GetNextMasternodeInQueueForPayment -- payment queue out of date, rebuilding\n");
+            RebuildPaymentQueue();
+            return GetNextMasternodeInQueueForPayment(nBlockHeight, fFilterSigTime, nCountRet, mnInfoRet);
+        }
+        CMasternode& mn = it->second;
+
+        if(!mn.IsValidForPayment()) continue;
 
         //check protocol version
-        if(mnpair.second.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
+        if(mn.nProtocolVersion < nMinProtocol) continue;
 
-        //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mnpair.second, nBlockHeight)) continue;
+        //it's in the list -- so let's skip it
+        if(!setScheduledPayees.empty() &&
+            setScheduledPayees.count(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()))) continue;
 
         //it's too new, wait for a cycle
-        if(fFilterSigTime && mnpair.second.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
+        if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
 
         //make sure it has at least as many confirmations as there are masternodes
-        if(GetUTXOConfirmations(mnpair.first) < nMnCount) continue;
+        int nCollateralHeight = GetCollateralHeight(it->first);
+        if(nCollateralHeight < 0 || chainActive.Height() - nCollateralHeight + 1 < nMnCount) continue;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
+        nCountRet++;
+        if((int)vecOldest.size() < nTenthNetwork) {
+            vecOldest.push_back(&mn);
+        }
     }
 
-    nCountRet = (int)vecMasternodeLastPaid.size();
-
     //when the network is in the process of upgrading, don't penalize nodes that recently restarted
     if(fFilterSigTime && nCountRet < nMnCount/3)
         return GetNextMasternodeInQueueForPayment(nBlockHeight, false, nCountRet, mnInfoRet);
 
-    // Sort them low to high
-    sort(vecMasternodeLastPaid.begin(), vecMasternodeLastPaid.end(), CompareLastPaidBlock());
-
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
         LogPrintf("CMasternode::GetNextMasternodeInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight - 101);
@@ -546,19 +569,15 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
     // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
     //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
     //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
-    //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
-    int nCountTenth = 0;
+    //  -- (chance per block * chances before the scheduled check will fire)
     arith_uint256 nHighest = 0;
     CMasternode *pBestMasternode = NULL;
-    BOOST_FOREACH (PAIRTYPE(int, CMasternode*)& s, vecMasternodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+    BOOST_FOREACH (CMasternode* pmn, vecOldest) {
+        arith_uint256 nScore = pmn->CalculateScore(blockHash);
         if(nScore > nHighest){
             nHighest = nScore;
-            pBestMasternode = s.second;
+            pBestMasternode = pmn;
         }
-        nCountTenth++;
-        if(nCountTenth >= nTenthNetwork) break;
     }
     if (pBestMasternode) {
         mnInfoRet = pBestMasternode->GetInfo();
@@ -566,6 +585,63 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
     return mnInfoRet.fInfoValid;
 }
 
+void CMasternodeMan::UpdatePaymentQueue(const CMasternode& mn)
+{
+    AssertLockHeld(cs);
+
+    const COutPoint& outpoint = mn.vin.prevout;
+    int nLastPaid = mn.nBlockLastPaid;
+
+    std::map<COutPoint, int>::iterator it = mapPaymentQueueLastPaid.find(outpoint);
+    if(it != mapPaymentQueueLastPaid.end()) {
+        if(it->second == nLastPaid) return;
+        setPaymentQueue.erase(std::make_pair(it->second, outpoint));
+        it->second = nLastPaid;
+    } else {
+        mapPaymentQueueLastPaid.insert(std::make_pair(outpoint, nLastPaid));
+    }
+    setPaymentQueue.insert(std::make_pair(nLastPaid, outpoint));
+}
+
+void CMasternodeMan::RemoveFromPaymentQueue(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs);
+
+    std::map<COutPoint, int>::iterator it = mapPaymentQueueLastPaid.find(outpoint);
+    if(it != mapPaymentQueueLastPaid.end()) {
+        setPaymentQueue.erase(std::make_pair(it->second, outpoint));
+        mapPaymentQueueLastPaid.erase(it);
+    }
+    mapCollateralHeight.erase(outpoint);
+}
+
+void CMasternodeMan::RebuildPaymentQueue()
+{
+    AssertLockHeld(cs);
+
+    setPaymentQueue.clear();
+    mapPaymentQueueLastPaid.clear();
+    for (const auto& mnpair : mapMasternodes) {
+        UpdatePaymentQueue(mnpair.second);
+    }
+}
+
+int CMasternodeMan::GetCollateralHeight(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs);
+
+    std::map<COutPoint, int>::iterator it = mapCollateralHeight.find(outpoint);
+    if(it != mapCollateralHeight.end()) return it->second;
+
+    // -1 means UTXO is yet unknown or already spent, ask again next time
+    int nHeight = GetUTXOHeight(outpoint);
+    if(nHeight > -1) {
+        mapCollateralHeight.insert(std::make_pair(outpoint, nHeight));
+    }
+    return nHeight;
+}
+
 masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint> &vecToExclude, int nProtocolVersion)
 {
     LOCK(cs);
@@ -609,6 +685,36 @@ masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint
     return masternode_info_t();
 }
 
+bool CMasternodeMan::GetSeenMasternodeBroadcast(const uint256& hash, CMasternodeBroadcast& mnbRet)
+{
+    LOCK(cs);
+    std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> >::iterator it = mapSeenMasternodeBroadcast.find(hash);
+    if (it == mapSeenMasternodeBroadcast.end())
+        return false;
+    mnbRet = it->second.second;
+    return true;
+}
+
+bool CMasternodeMan::GetSeenMasternodePing(const uint256& hash, CMasternodePing& mnpRet)
+{
+    LOCK(cs);
+    std::map<uint256, CMasternodePing>::iterator it = mapSeenMasternodePing.find(hash);
+    if (it == mapSeenMasternodePing.end())
+        return false;
+    mnpRet = it->second;
+    return true;
+}
+
+bool CMasternodeMan::GetSeenMasternodeVerification(const uint256& hash, CMasternodeVerification& mnvRet)
+{
+    LOCK(cs);
+    std::map<uint256, CMasternodeVerification>::iterator it = mapSeenMasternodeVerification.find(hash);
+    if (it == mapSeenMasternodeVerification.end())
+        return false;
+    mnvRet = it->second;
+    return true;
+}
+
 bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeMan::score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol)
 {
     vecMasternodeScoresRet.clear();
@@ -632,6 +738,31 @@ bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeM
     return !vecMasternodeScoresRet.empty();
 }
 
+bool CMasternodeMan::GetMasternodeRankTable(const uint256& nBlockHash, int nMinProtocol, CMasternodeMan::rank_table_ptr_t& pTableRet)
+{
+    AssertLockHeld(cs);
+
+    std::pair<uint256, int> key = std::make_pair(nBlockHash, nMinProtocol);
+    if (mapRankTables.Get(key, pTableRet)) {
+        mapRankTables.Touch(key);
+        return true;
+    }
+
+    std::shared_ptr<rank_table_t> pTable = std::make_shared<rank_table_t>();
+    if (!GetMasternodeScores(nBlockHash, pTable->vecScores, nMinProtocol))
+        return false;
+
+    int nRank = 0;
+    for (auto& scorePair : pTable->vecScores) {
+        nRank++;
+        pTable->mapRanks.insert(std::make_pair(scorePair.second->vin.prevout, nRank));
+    }
+
+    mapRankTables.Insert(key, pTable);
+    pTableRet = pTable;
+    return true;
+}
+
 bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
 {
     nRankRet = -1;
@@ -646,22 +777,25 @@ bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet,
         return false;
     }
 
+    return GetMasternodeRank(outpoint, nRankRet, nBlockHash, nMinProtocol);
+}
+
+bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet, const uint256& nBlockHash, int nMinProtocol)
+{
+    nRankRet = -1;
+
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    rank_table_ptr_t pTable;
+    if (!GetMasternodeRankTable(nBlockHash, nMinProtocol, pTable))
         return false;
 
-    int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == outpoint) {
-            nRankRet = nRank;
-            return true;
-        }
-    }
+    std::map<COutPoint, int>::const_iterator it = pTable->mapRanks.find(outpoint);
+    if (it == pTable->mapRanks.end())
+        return false;
 
-    return false;
+    nRankRet = it->second;
+    return true;
 }
 
 bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMasternodeRanksRet, int nBlockHeight, int nMinProtocol)
@@ -680,12 +814,12 @@ bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMast
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    rank_table_ptr_t pTable;
+    if (!GetMasternodeRankTable(nBlockHash, nMinProtocol, pTable))
         return false;
 
     int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
+    for (auto& scorePair : pTable->vecScores) {
         nRank++;
         vecMasternodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
     }
@@ -1341,10 +1475,14 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
         }
     } else {
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
+        int nProtocolVersionOld = pmn->nProtocolVersion;
         if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - seen");
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
+        if(pmn->nProtocolVersion != nProtocolVersionOld) {
+            mapRankTables.Clear();
+        }
     }
 }
 
@@ -1403,7 +1541,13 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         CMasternode* pmn = Find(mnb.vin.prevout);
         if(pmn) {
             CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-            if(!mnb.Update(pmn, nDos, connman)) {
+            int nProtocolVersionOld = pmn->nProtocolVersion;
+            bool fUpdated = mnb.Update(pmn, nDos, connman);
+            if(pmn->nProtocolVersion != nProtocolVersionOld) {
+                // rank tables filter by protocol version
+                mapRankTables.Clear();
+            }
+            if(!fUpdated) {
                 LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
@@ -1447,19 +1591,11 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 
     if(fLiteMode || !masternodeSync.IsWinnersListSynced() || mapMasternodes.empty()) return;
 
-    static bool IsFirstRun = true;
-    // Do full scan on first run or if we are not a masternode
-    // (MNs should update this info on every block, so limited scan should be enough for them)
-    int nMaxBlocksToScanBack = (IsFirstRun || !fMasterNode) ? mnpayments.GetStorageLimit() : LAST_PAID_SCAN_BLOCKS;
-
-    // LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
-    //                         nCachedBlockHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
-
+    // Payments are indexed per block by mnpaidindex, this is just a lookup per masternode
     for (auto& mnpair: mapMasternodes) {
-        mnpair.second.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+        mnpair.second.UpdateLastPaid(pindex);
+        UpdatePaymentQueue(mnpair.second);
     }
-
-    IsFirstRun = false;
 }
 
 void CMasternodeMan::UpdateWatchdogVoteTime(const COutPoint& outpoint, uint64_t nVoteTime)
@@ -1545,6 +1681,15 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     nCachedBlockHeight = pindex->nHeight;
     LogPrint("masternode", "CMasternodeMan::UpdatedBlockTip -- nCachedBlockHeight=%d\n", nCachedBlockHeight);
 
+    {
+        LOCK(cs);
+        // collateral heights are only known to be right on the chain they were looked up on
+        if(pindexCollateralHeightTip && pindex->GetAncestor(pindexCollateralHeightTip->nHeight) != pindexCollateralHeightTip) {
+            mapCollateralHeight.clear();
+        }
+        pindexCollateralHeightTip = pindex;
+    }
+
     CheckSameAddr();
 
     if(fMasterNode) {
@@ -5,9 +5,12 @@
 #ifndef MASTERNODEMAN_H
 #define MASTERNODEMAN_H
 
+#include "cachemap.h"
 #include "masternode.h"
 #include "sync.h"
 
+#include <memory>
+
 using namespace std;
 
 class CMasternodeMan;
@@ -28,8 +31,6 @@ private:
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
 
-    static const int LAST_PAID_SCAN_BLOCKS      = 100;
-
     static const int MIN_POSE_PROTO_VERSION     = 70203;
     static const int MAX_POSE_CONNECTIONS       = 10;
     static const int MAX_POSE_RANK              = 10;
@@ -41,6 +42,15 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int RANK_TABLE_CACHE_SIZE          = 8;
+
+    /// Masternode scores for one block hash, highest first, and the rank of each
+    struct rank_table_t {
+        score_pair_vec_t vecScores;
+        std::map<COutPoint, int> mapRanks;
+    };
+    typedef std::shared_ptr<const rank_table_t> rank_table_ptr_t;
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -72,6 +82,20 @@ private:
 
     std::vector<uint256> vecDirtyGovernanceObjectHashes;
 
+    // masternodes ordered by last paid block (and outpoint), the order
+    // GetNextMasternodeInQueueForPayment considers them in
+    std::set<std::pair<int, COutPoint> > setPaymentQueue;
+    // last paid block each masternode is queued under in setPaymentQueue
+    std::map<COutPoint, int> mapPaymentQueueLastPaid;
+    // collateral heights, these only change when the collateral is reorged
+    std::map<COutPoint, int> mapCollateralHeight;
+    // tip mapCollateralHeight is valid for
+    const CBlockIndex* pindexCollateralHeightTip;
+
+    // rank tables by (block hash, min protocol), least recently used are dropped first.
+    // Cleared whenever masternodes are added or removed or change protocol version.
+    CacheMap<std::pair<uint256, int>, rank_table_ptr_t> mapRankTables;
+
     int64_t nLastWatchdogVoteTime;
 
     friend class CMasternodeSync;
@@ -79,6 +103,13 @@ private:
     CMasternode* Find(const COutPoint& outpoint);
 
     bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
+    bool GetMasternodeRankTable(const uint256& nBlockHash, int nMinProtocol, rank_table_ptr_t& pTableRet);
+
+    /// Move an entry to its current last paid block in the payment queue
+    void UpdatePaymentQueue(const CMasternode& mn);
+    void RemoveFromPaymentQueue(const COutPoint& outpoint);
+    void RebuildPaymentQueue();
+    int GetCollateralHeight(const COutPoint& outpoint);
 
 public:
     // Keep track of all broadcasts I've seen
@@ -105,6 +136,11 @@ public:
             READWRITE(strVersion);
         }
 
+        if(ser_action.ForRead()) {
+            // cached rank tables point into mapMasternodes which is about to be replaced
+            mapRankTables.Clear();
+        }
+
         READWRITE(mapMasternodes);
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
@@ -177,6 +213,8 @@ public:
 
     bool GetMasternodeRanks(rank_pair_vec_t& vecMasternodeRanksRet, int nBlockHeight = -1, int nMinProtocol = 0);
     bool GetMasternodeRank(const COutPoint &outpoint, int& nRankRet, int nBlockHeight = -1, int nMinProtocol = 0);
+    /// Same as above for a known block hash, the caller is responsible for checking masternode sync
+    bool GetMasternodeRank(const COutPoint &outpoint, int& nRankRet, const uint256& nBlockHash, int nMinProtocol = 0);
 
     void ProcessMasternodeConnections(CConnman& connman);
     std::pair<CService, std::set<uint256> > PopScheduledMnbRequestConnection();
@@ -201,6 +239,13 @@ public:
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos, CConnman& connman);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    bool HasSeenMasternodeBroadcast(const uint256& hash) { LOCK(cs); return mapSeenMasternodeBroadcast.count(hash); }
+    bool HasSeenMasternodePing(const uint256& hash) { LOCK(cs); return mapSeenMasternodePing.count(hash); }
+    bool GetSeenMasternodeBroadcast(const uint256& hash, CMasternodeBroadcast& mnbRet);
+    bool GetSeenMasternodePing(const uint256& hash, CMasternodePing& mnpRet);
+    bool HasSeenMasternodeVerification(const uint256& hash) { LOCK(cs); return mapSeenMasternodeVerification.count(hash); }
+    bool GetSeenMasternodeVerification(const uint256& hash, CMasternodeVerification& mnvRet);
+
     void UpdateLastPaid(const CBlockIndex* pindex);
 
     void AddDirtyGovernanceObjectHash(const uint256& nHash)
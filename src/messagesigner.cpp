@@ -3,12 +3,67 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "checkqueue.h"
 #include "hash.h"
+#include "memusage.h"
+#include "random.h"
 #include "validation.h" // For strMessageMagic
 #include "messagesigner.h"
 #include "tinyformat.h"
+#include "util.h"
 #include "utilstrencodings.h"
 
+#include <boost/thread.hpp>
+
+namespace {
+
+CHashSignatureCache& GetHashSignatureCache()
+{
+    static CHashSignatureCache hashSignatureCache;
+    return hashSignatureCache;
+}
+
+CCheckQueue<CHashSignerCheck> hashsignercheckqueue(128);
+
+}
+
+void ThreadHashSignerCheck() {
+    RenameThread("sov-sigch");
+    hashsignercheckqueue.Thread();
+}
+
+CHashSignatureCache::CHashSignatureCache(size_t nMaxSizeIn) :
+    nMaxSize(nMaxSizeIn)
+{
+    GetRandBytes(nonce.begin(), 32);
+}
+
+void CHashSignatureCache::ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+{
+    CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+}
+
+bool CHashSignatureCache::Get(const uint256& entry)
+{
+    boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+    return setValid.count(entry);
+}
+
+void CHashSignatureCache::Set(const uint256& entry)
+{
+    boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+    while (!setValid.empty() && memusage::DynamicUsage(setValid) > nMaxSize)
+    {
+        map_type::size_type s = GetRand(setValid.bucket_count());
+        map_type::local_iterator it = setValid.begin(s);
+        if (it != setValid.end(s)) {
+            setValid.erase(*it);
+        }
+    }
+
+    setValid.insert(entry);
+}
+
 bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     CSOVSecret vchSecret;
@@ -22,21 +77,22 @@ bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet
 }
 
 bool CMessageSigner::SignMessage(const std::string strMessage, std::vector<unsigned char>& vchSigRet, const CKey key)
+{
+    return CHashSigner::SignHash(GetMessageHash(strMessage), key, vchSigRet);
+}
+
+uint256 CMessageSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
 
-    return CHashSigner::SignHash(ss.GetHash(), key, vchSigRet);
+    return ss.GetHash();
 }
 
 bool CMessageSigner::VerifyMessage(const CPubKey pubkey, const std::vector<unsigned char>& vchSig, const std::string strMessage, std::string& strErrorRet)
 {
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << strMessageMagic;
-    ss << strMessage;
-
-    return CHashSigner::VerifyHash(ss.GetHash(), pubkey, vchSig, strErrorRet);
+    return CHashSigner::VerifyHash(GetMessageHash(strMessage), pubkey, vchSig, strErrorRet);
 }
 
 bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsigned char>& vchSigRet)
@@ -46,6 +102,13 @@ bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsi
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
+    CHashSignatureCache& hashSignatureCache = GetHashSignatureCache();
+    uint256 entry;
+    hashSignatureCache.ComputeEntry(entry, hash, vchSig, pubkey);
+    if(hashSignatureCache.Get(entry)) {
+        return true;
+    }
+
     CPubKey pubkeyFromSig;
     if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
@@ -59,5 +122,35 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey pubkey, const st
         return false;
     }
 
+    hashSignatureCache.Set(entry);
+    return true;
+}
+
+bool CHashSignerCheck::operator()()
+{
+    CPubKey pubkeyFromSig;
+    if(pubkeyFromSig.RecoverCompact(hash, vchSig)) {
+        uint256 entry;
+        GetHashSignatureCache().ComputeEntry(entry, hash, vchSig, pubkeyFromSig);
+        GetHashSignatureCache().Set(entry);
+    }
     return true;
 }
+
+void CHashSignerCheck::PrecomputeSignatures(std::vector<CHashSignerCheck>& vChecks)
+{
+    // CCheckQueue supports a single master at a time, other message handler
+    // threads recover their batches on their own meanwhile
+    static CCriticalSection cs_hashsignercheck;
+    TRY_LOCK(cs_hashsignercheck, lockQueue);
+
+    if (!lockQueue || nScriptCheckThreads <= 1) {
+        BOOST_FOREACH(CHashSignerCheck& check, vChecks)
+            check();
+        return;
+    }
+
+    CCheckQueueControl<CHashSignerCheck> control(&hashsignercheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
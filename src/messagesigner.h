@@ -7,6 +7,50 @@
 
 #include "key.h"
 
+#include <vector>
+
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/unordered_set.hpp>
+
+/** Recover the signers of queued message hashes, see CHashSignerCheck::PrecomputeSignatures() */
+void ThreadHashSignerCheck();
+
+/** Maximum memory used by the hash signature cache, in bytes */
+static const size_t MAX_HASH_SIGNATURE_CACHE_SIZE = 8 << 20;
+
+class CHashSignatureCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Valid masternode, governance and InstantSend signature cache, like the
+ * script CSignatureCache. Lets signatures recovered ahead of time by
+ * CHashSignerCheck, and signatures seen again (relayed broadcasts, votes
+ * checked once more on masternode list changes), skip key recovery.
+ */
+class CHashSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || hash || public key || signature):
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CHashSignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+    //! Random entries are evicted while the cache uses more than this many bytes
+    size_t nMaxSize;
+
+public:
+    CHashSignatureCache(size_t nMaxSizeIn = MAX_HASH_SIGNATURE_CACHE_SIZE);
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey);
+    bool Get(const uint256& entry);
+    void Set(const uint256& entry);
+};
+
 /** Helper class for signing messages and checking their signatures
  */
 class CMessageSigner
@@ -16,6 +60,8 @@ public:
     static bool GetKeysFromSecret(const std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet);
     /// Sign the message, returns true if successful
     static bool SignMessage(const std::string strMessage, std::vector<unsigned char>& vchSigRet, const CKey key);
+    /// Hash of the message as signed by SignMessage()
+    static uint256 GetMessageHash(const std::string& strMessage);
     /// Verify the message signature, returns true if succcessful
     static bool VerifyMessage(const CPubKey pubkey, const std::vector<unsigned char>& vchSig, const std::string strMessage, std::string& strErrorRet);
 };
@@ -31,4 +77,32 @@ public:
     static bool VerifyHash(const uint256& hash, const CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
 };
 
+/**
+ * Closure recovering the public key of one hash signature, for CCheckQueue.
+ * The recovered key is stored in the signature cache so that the following
+ * VerifyHash() of the same signature is a lookup. Never fails: invalid
+ * signatures are reported by VerifyHash() itself.
+ */
+class CHashSignerCheck
+{
+private:
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+
+public:
+    CHashSignerCheck() {}
+    CHashSignerCheck(const uint256& hashIn, const std::vector<unsigned char>& vchSigIn) :
+        hash(hashIn), vchSig(vchSigIn) { }
+
+    bool operator()();
+
+    void swap(CHashSignerCheck &check) {
+        std::swap(hash, check.hash);
+        vchSig.swap(check.vchSig);
+    }
+
+    /// Recover all signatures of vChecks, in parallel if script check threads are enabled
+    static void PrecomputeSignatures(std::vector<CHashSignerCheck>& vChecks);
+};
+
 #endif
@@ -30,6 +30,7 @@
 
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <memory>
 #include <queue>
 
 using namespace std;
@@ -132,7 +133,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
         const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
 
         // Add our coinbase tx as first transaction
-        pblock->vtx.push_back(txNew);
+        pblock->vtx.push_back(MakeTransactionRef(txNew));
         pblocktemplate->vTxFees.push_back(-1); // updated at end
         pblocktemplate->vTxSigOps.push_back(-1); // updated at end
         pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
@@ -241,7 +242,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
 
                 CAmount nTxFees = iter->GetFee();
                 // Added
-                pblock->vtx.push_back(tx);
+                pblock->vtx.push_back(iter->GetSharedTx());
                 pblocktemplate->vTxFees.push_back(nTxFees);
                 pblocktemplate->vTxSigOps.push_back(nTxSigOps);
                 nBlockSize += nTxSize;
@@ -300,7 +301,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
         LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
 
         // Update block coinbase
-        pblock->vtx[0] = txNew;
+        pblock->vtx[0] = MakeTransactionRef(std::move(txNew));
         pblocktemplate->vTxFees[0] = -nFees;
 
         // Fill in header
@@ -308,7 +309,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
         UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
         pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
         pblock->nNonce         = 0;
-        pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
+        pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(*pblock->vtx[0]);
 
         CValidationState state;
         if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
@@ -319,6 +320,17 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
     return pblocktemplate.release();
 }
 
+static void SetExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int nExtraNonce)
+{
+    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -329,13 +341,7 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
-    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
-    CMutableTransaction txCoinbase(pblock->vtx[0]);
-    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
-    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
-
-    pblock->vtx[0] = txCoinbase;
-    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+    SetExtraNonce(pblock, pindexPrev, nExtraNonce);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -380,7 +386,7 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
 static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainparams)
 {
     LogPrintf("%s\n", pblock->ToString());
-    LogPrintf("generated %s\n", FormatMoney(pblock->vtx[0].vout[0].nValue));
+    LogPrintf("generated %s\n", FormatMoney(pblock->vtx[0]->vout[0].nValue));
 
     // Found a solution
     {
@@ -399,17 +405,76 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
+// Block template shared by the miner threads. Whichever thread first notices
+// that the tip moved, or that the mempool changed a while ago, rebuilds it;
+// the others pick the new one up on their next pass.
+static CCriticalSection cs_minertemplate;
+static std::shared_ptr<const CBlockTemplate> pminertemplate;
+static CBlockIndex* pindexMinerTemplatePrev = NULL;
+static unsigned int nMinerTemplateTransactionsUpdated = 0;
+static int64_t nMinerTemplateTime = 0;
+
+// Hashes per second of each miner thread, refreshed every few seconds
+static CCriticalSection cs_minerhashrate;
+static std::vector<double> vMinerHashesPerSec;
+
+static std::shared_ptr<const CBlockTemplate> GetMinerTemplate(const CChainParams& chainparams, const CScript& scriptPubKey, CBlockIndex*& pindexPrev)
+{
+    LOCK(cs_minertemplate);
+    CBlockIndex* pindexTip = chainActive.Tip();
+    unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    if (!pminertemplate || pindexMinerTemplatePrev != pindexTip ||
+        (nTransactionsUpdated != nMinerTemplateTransactionsUpdated && GetTime() - nMinerTemplateTime > 60))
+    {
+        pminertemplate.reset(CreateNewBlock(chainparams, scriptPubKey));
+        pindexMinerTemplatePrev = pindexTip;
+        nMinerTemplateTransactionsUpdated = nTransactionsUpdated;
+        nMinerTemplateTime = GetTime();
+        if (pminertemplate) {
+            LogPrintf("SOVMiner -- Running miner with %u transactions in block (%u bytes)\n", pminertemplate->block.vtx.size(),
+                ::GetSerializeSize(pminertemplate->block, SER_NETWORK, PROTOCOL_VERSION));
+        }
+    }
+    pindexPrev = pindexMinerTemplatePrev;
+    return pminertemplate;
+}
+
+static void SetMinerHashesPerSec(int nThread, double dHashesPerSec)
+{
+    LOCK(cs_minerhashrate);
+    if (nThread < (int)vMinerHashesPerSec.size())
+        vMinerHashesPerSec[nThread] = dHashesPerSec;
+}
+
+double GetMinerHashesPerSec(std::vector<double>& vThreadHashesPerSec)
+{
+    LOCK(cs_minerhashrate);
+    vThreadHashesPerSec = vMinerHashesPerSec;
+    double dTotal = 0;
+    BOOST_FOREACH(double dHashesPerSec, vMinerHashesPerSec)
+        dTotal += dHashesPerSec;
+    return dTotal;
+}
+
 // ***TODO*** that part changed in sov, we are using a mix with old one here for now
-void static SOVMiner(const CChainParams& chainparams, CConnman& connman)
+void static SOVMiner(const CChainParams& chainparams, CConnman& connman, boost::shared_ptr<CReserveScript> coinbaseScript, int nThread, int nThreads)
 {
-    LogPrintf("SOVMiner -- started\n");
+    LogPrintf("SOVMiner -- started thread %d\n", nThread);
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread("sov-miner");
 
+    // Thread n only uses the extranonces n+1, n+1+nThreads, n+1+2*nThreads, ...
+    // so no two threads ever hash the same coinbase, and each owns the whole
+    // nonce range of every block it builds.
+    std::shared_ptr<const CBlockTemplate> pblocktemplateLast;
     unsigned int nExtraNonce = 0;
 
-    boost::shared_ptr<CReserveScript> coinbaseScript;
-    GetMainSignals().ScriptForMining(coinbaseScript);
+    CX16RMidstate midstate;
+    uint32_t vNonce[256];
+    uint256 vHash[256];
+
+    uint64_t nHashesDone = 0;
+    int64_t nHashRateStart = GetTimeMillis();
 
     try {
         // Throw an error if no script was provided.  This can happen
@@ -435,42 +500,60 @@ void static SOVMiner(const CChainParams& chainparams, CConnman& connman)
             // Create new block
             //
             unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-            CBlockIndex* pindexPrev = chainActive.Tip();
-            if(!pindexPrev) break;
+            if (!chainActive.Tip()) break;
 
-            std::unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(chainparams, coinbaseScript->reserveScript));
-            if (!pblocktemplate.get())
+            CBlockIndex* pindexPrev = NULL;
+            std::shared_ptr<const CBlockTemplate> pblocktemplate = GetMinerTemplate(chainparams, coinbaseScript->reserveScript, pindexPrev);
+            if (!pblocktemplate)
             {
                 LogPrintf("SOVMiner -- Keypool ran out, please call keypoolrefill before restarting the mining thread\n");
                 return;
             }
-            CBlock *pblock = &pblocktemplate->block;
-            IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
-
-            LogPrintf("SOVMiner -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
-                ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
+            if (pblocktemplate != pblocktemplateLast) {
+                pblocktemplateLast = pblocktemplate;
+                nExtraNonce = nThread + 1;
+            } else {
+                nExtraNonce += nThreads;
+            }
+            CBlock block(pblocktemplate->block);
+            CBlock *pblock = &block;
+            SetExtraNonce(pblock, pindexPrev, nExtraNonce);
 
             //
             // Search
             //
             int64_t nStart = GetTime();
+            int64_t nLastPeerCheck = nStart;
             arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
             while (true)
             {
-                unsigned int nHashesDone = 0;
-
-                uint256 hash;
-                while (true)
+                // Only the nonce changes until the checks below, so scan the nonces
+                // up to the next multiple of 256 in one batch from a midstate of the
+                // rest of the header.
+                midstate.Reset((const unsigned char*)BEGIN(pblock->nVersion),
+                    BEGIN(pblock->nNonce) - BEGIN(pblock->nVersion), pblock->hashPrevBlock);
+                unsigned int nBatch = 256 - (pblock->nNonce & 0xFF);
+                for (unsigned int i = 0; i < nBatch; i++)
+                    vNonce[i] = pblock->nNonce + i;
+                midstate.Hash(vNonce, nBatch, vHash);
+                nHashesDone += nBatch;
+
+                for (unsigned int i = 0; i < nBatch; i++)
                 {
-                    hash = pblock->GetHash();
-                    if (UintToArith256(hash) <= hashTarget)
+                    if (UintToArith256(vHash[i]) <= hashTarget)
                     {
                         // Found a solution
+                        pblock->nNonce = vNonce[i];
+                        pblock->SetCachedHash(vHash[i]);
                         SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                        LogPrintf("SOVMiner:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), hashTarget.GetHex());
+                        LogPrintf("SOVMiner:\n  proof-of-work found\n  hash: %s\n  target: %s\n", vHash[i].GetHex(), hashTarget.GetHex());
                         ProcessBlockFound(pblock, chainparams);
                         SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        coinbaseScript->KeepScript();
+                        {
+                            // The coinbase script is shared by all miner threads
+                            LOCK(cs_minertemplate);
+                            coinbaseScript->KeepScript();
+                        }
 
                         // In regression test mode, stop mining after a block is found. This
                         // allows developers to controllably generate a block on demand.
@@ -480,16 +563,24 @@ void static SOVMiner(const CChainParams& chainparams, CConnman& connman)
                         break;
                     }
                     pblock->nNonce += 1;
-                    nHashesDone += 1;
-                    if ((pblock->nNonce & 0xFF) == 0)
-                        break;
+                }
+
+                int64_t nNow = GetTimeMillis();
+                if (nNow - nHashRateStart >= 4000) {
+                    SetMinerHashesPerSec(nThread, nHashesDone * 1000.0 / (nNow - nHashRateStart));
+                    nHashesDone = 0;
+                    nHashRateStart = nNow;
                 }
 
                 // Check for stop or if block needs to be rebuilt
                 boost::this_thread::interruption_point();
-                // Regtest mode doesn't require peers
-                if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 && chainparams.MiningRequiresPeers())
-                    break;
+                // Regtest mode doesn't require peers. GetNodeCount() takes cs_vNodes,
+                // so only look at the peer count once a second.
+                if (chainparams.MiningRequiresPeers() && GetTime() != nLastPeerCheck) {
+                    nLastPeerCheck = GetTime();
+                    if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
+                        break;
+                }
                 if (pblock->nNonce >= 0xffff0000)
                     break;
                 if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
@@ -512,13 +603,16 @@ void static SOVMiner(const CChainParams& chainparams, CConnman& connman)
     catch (const boost::thread_interrupted&)
     {
         LogPrintf("SOVMiner -- terminated\n");
+        SetMinerHashesPerSec(nThread, 0);
         throw;
     }
     catch (const std::runtime_error &e)
     {
         LogPrintf("SOVMiner -- runtime error: %s\n", e.what());
+        SetMinerHashesPerSec(nThread, 0);
         return;
     }
+    SetMinerHashesPerSec(nThread, 0);
 }
 
 void GenerateSOVs(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman& connman)
@@ -530,15 +624,36 @@ void GenerateSOVs(bool fGenerate, int nThreads, const CChainParams& chainparams,
 
     if (minerThreads != NULL)
     {
+        // The threads share the block template and hash rate table, let them
+        // finish before those are reset.
         minerThreads->interrupt_all();
+        minerThreads->join_all();
         delete minerThreads;
         minerThreads = NULL;
     }
 
+    {
+        LOCK(cs_minertemplate);
+        pminertemplate.reset();
+        pindexMinerTemplatePrev = NULL;
+    }
+    {
+        LOCK(cs_minerhashrate);
+        vMinerHashesPerSec.clear();
+    }
+
     if (nThreads == 0 || !fGenerate)
         return;
 
+    boost::shared_ptr<CReserveScript> coinbaseScript;
+    GetMainSignals().ScriptForMining(coinbaseScript);
+
+    {
+        LOCK(cs_minerhashrate);
+        vMinerHashesPerSec.assign(nThreads, 0);
+    }
+
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&SOVMiner, boost::cref(chainparams), boost::ref(connman)));
+        minerThreads->create_thread(boost::bind(&SOVMiner, boost::cref(chainparams), boost::ref(connman), coinbaseScript, i, nThreads));
 }
@@ -32,6 +32,8 @@ struct CBlockTemplate
 
 /** Run the miner threads */
 void GenerateSOVs(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman& connman);
+/** Hashes per second of the miner threads, in total and for each thread */
+double GetMinerHashesPerSec(std::vector<double>& vThreadHashesPerSec);
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn);
 /** Modify the extranonce in a block */
@@ -12,6 +12,7 @@
 #include "compat.h"
 #include "limitedmap.h"
 #include "netaddress.h"
+#include "primitives/transaction.h"
 #include "protocol.h"
 #include "random.h"
 #include "streams.h"
@@ -26,6 +27,7 @@
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <set>
 
 #ifndef WIN32
 #include <arpa/inet.h>
@@ -85,6 +87,10 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default number of message handler threads, each processing a different peer at a time */
+static const int DEFAULT_MSG_HANDLER_THREADS = 4;
+/** Maximum number of message handler threads */
+static const int MAX_MSG_HANDLER_THREADS = 16;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -127,6 +133,7 @@ public:
         CClientUIInterface* uiInterface = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        int nMsgHandlerThreads = 1;
     };
     CConnman();
     ~CConnman();
@@ -201,6 +208,18 @@ public:
         PushMessageWithVersionAndFlag(pnode, 0, 0, sCommand, std::forward<Args>(args)...);
     }
 
+    /** Build a complete message, header included, that can be pushed as is to any peer */
+    template <typename... Args>
+    CDataStream MakeMessage(CNode* pnode, const std::string& sCommand, Args&&... args)
+    {
+        auto msg(BeginMessage(pnode, 0, 0, sCommand));
+        ::SerializeMany(msg, msg.nType, msg.nVersion, std::forward<Args>(args)...);
+        EndMessage(msg);
+        return msg;
+    }
+
+    void PushMessage(CNode* pnode, const CDataStream& strm, const std::string& sCommand);
+
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
     {
@@ -305,7 +324,6 @@ public:
     void ReleaseNodeVector(const std::vector<CNode*>& vecNodes);
 
     void RelayTransaction(const CTransaction& tx);
-    void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
     void RelayInv(CInv &inv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
 
     // Addrman functions
@@ -400,6 +418,16 @@ private:
     void ThreadOpenConnections();
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    /** Add the socket of a new node to the sockets waited on */
+    void RegisterSocketEvents(CNode* pnode);
+    /**
+     * Wait for sockets to become ready, marking the nodes ready to receive or send and adding the listening sockets ready to accept to setListenReady.
+     * vNodesReady is filled with the referenced nodes to service: every node with select(), only the ready and pending ones with epoll.
+     */
+    void SocketEvents(bool fMoreWork, std::vector<CNode*>& vNodesReady, std::set<SOCKET>& setListenReady);
+    /** Receive from the socket of a node, returns true if data was read and more may be available */
+    bool SocketRecvData(CNode* pnode);
+    void InactivityCheck(CNode* pnode);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadMnbRequestConnections();
@@ -430,7 +458,6 @@ private:
     void DumpBanlist();
 
     CDataStream BeginMessage(CNode* node, int nVersion, int flags, const std::string& sCommand);
-    void PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand);
     void EndMessage(CDataStream& strm);
 
     // Network stats
@@ -490,8 +517,18 @@ private:
     std::atomic<int> nBestHeight;
     CClientUIInterface* clientInterface;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
+    /** Counter for waking the message processors, bumped on every wake up. */
+    uint64_t nMsgProcWake;
+    int nMsgHandlerThreads;
+    /** Peer index the next message handler pass starts at, spreading the handlers over the peers */
+    std::atomic<unsigned int> nMsgHandlerNextNode;
+
+#ifdef USE_EPOLL
+    /** epoll instance watching the listening sockets and the sockets of all nodes */
+    int hEpoll;
+    /** Nodes still ready to receive or send after their last service, which no new edge will report, only used by the socket handler thread */
+    std::set<CNode*> setNodesPending;
+#endif
 
     std::condition_variable condMsgProc;
     std::mutex mutexMsgProc;
@@ -504,7 +541,7 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMnbRequestConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 };
 extern std::unique_ptr<CConnman> g_connman;
 void Discover(boost::thread_group& threadGroup);
@@ -571,8 +608,8 @@ extern bool fDiscover;
 extern bool fListen;
 extern bool fRelayTxes;
 
-extern std::map<CInv, CDataStream> mapRelay;
-extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
+extern std::map<uint256, CTransactionRef> mapRelay;
+extern std::deque<std::pair<int64_t, uint256> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
 extern limitedmap<uint256, int64_t> mapAlreadyAskedFor;
 
@@ -611,6 +648,11 @@ public:
     double dPingTime;
     double dPingWait;
     double dMinPing;
+    size_t nProcessQueueMsgs;
+    size_t nProcessQueueBytes;
+    double dProcessTime;
+    CAmount minFeeFilter;
+    uint64_t nInvFeeFiltered;
     std::string addrLocal;
     CAddress addr;
 };
@@ -631,12 +673,15 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    bool fSigPrefetched;            // signatures already queued for recovery by the message handler
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fSigPrefetched = false;
     }
 
     bool complete() const
@@ -675,6 +720,11 @@ public:
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg;
     size_t nProcessQueueSize;
+    // set while a message handler thread processes this peer, so that its
+    // messages are handled in order by one thread at a time
+    std::atomic<bool> fMsgProcClaimed;
+    // time spent processing this peer's messages, in microseconds
+    std::atomic<int64_t> nProcessTimeUsec;
 
     std::deque<CInv> vRecvGetData;
     uint64_t nRecvBytes;
@@ -719,6 +769,10 @@ public:
 
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // Socket readiness, only used by the socket handler thread. With epoll
+    // these persist until a read or write would block.
+    bool fSocketRecvReady;
+    bool fSocketSendReady;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -765,6 +819,13 @@ public:
     int64_t nMinPingUsecTime;
     // Whether a ping is requested.
     bool fPingQueued;
+    // Minimum fee rate with which to filter inv's to this node
+    CAmount minFeeFilter;
+    CCriticalSection cs_feeFilter;
+    CAmount lastSentFeeFilter;
+    int64_t nextSendTimeFeeFilter;
+    // Transaction inv's to this node dropped by its fee filter
+    std::atomic<uint64_t> nInvFeeFiltered;
 
     std::vector<unsigned char> vchKeyedNetGroup;
 
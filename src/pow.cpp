@@ -12,12 +12,75 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
+#include "sync.h"
 #include "uint256.h"
 #include "util.h"
 
 #include <math.h>
 
-unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consensus::Params& params) {
+/**
+ * Difficulty state of the last few blocks GetNextWorkRequired() was asked
+ * about. Headers and blocks mostly arrive in order, so the window of the next
+ * one can usually be slid forward from its parent's instead of being rebuilt.
+ * Entries are looked up by CBlockIndex pointer and checked against the block
+ * hash, so index entries freed and reallocated by UnloadBlockIndex() or the
+ * unit tests can't alias. Index entries without a hash are never cached.
+ */
+namespace {
+
+struct CLwmaWindow
+{
+    const CBlockIndex* pindexLast;
+    uint256 hashLast;
+    int64_t T;
+    int64_t N;
+    int64_t k;
+    //! Sum of target / (k * N * N) over the window
+    arith_uint256 sumTarget;
+    //! Sum of the clamped solvetimes, weighted 1 (oldest) to N (newest)
+    int64_t nWeightedSolvetime;
+    //! Sum of the clamped solvetimes
+    int64_t nSolvetime;
+
+    CLwmaWindow() : pindexLast(NULL), T(0), N(0), k(0), nWeightedSolvetime(0), nSolvetime(0) {}
+};
+
+struct CDgwResult
+{
+    const CBlockIndex* pindexLast;
+    uint256 hashLast;
+    uint256 powLimit;
+    int64_t nPowTargetSpacing;
+    unsigned int nBits;
+
+    CDgwResult() : pindexLast(NULL), nPowTargetSpacing(0), nBits(0) {}
+};
+
+static const unsigned int DIFFICULTY_CACHE_SIZE = 8;
+
+CCriticalSection cs_difficultycache;
+CLwmaWindow lwmaCache[DIFFICULTY_CACHE_SIZE];
+unsigned int nLwmaCacheNext = 0;
+CDgwResult dgwCache[DIFFICULTY_CACHE_SIZE];
+unsigned int nDgwCacheNext = 0;
+
+bool IsCached(const CBlockIndex* pindexCached, const uint256& hashCached, const CBlockIndex* pindex)
+{
+    return pindex && pindexCached == pindex && pindex->phashBlock && hashCached == *pindex->phashBlock;
+}
+
+} // anon namespace
+
+void ClearDifficultyCache()
+{
+    LOCK(cs_difficultycache);
+    for (unsigned int i = 0; i < DIFFICULTY_CACHE_SIZE; i++) {
+        lwmaCache[i] = CLwmaWindow();
+        dgwCache[i] = CDgwResult();
+    }
+}
+
+unsigned int static DarkGravityWaveUncached(const CBlockIndex* pindexLast, const Consensus::Params& params) {
     /* current difficulty formula, sov - DarkGravity v3, written by Evan Duffield - evan@sov.org */
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
     int64_t nPastBlocks = 24;
@@ -67,6 +130,35 @@ unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consens
     return bnNew.GetCompact();
 }
 
+// DGW's running average is rounded at every step, starting from the newest
+// block, so unlike LWMA it can't be slid along exactly. It only runs for the
+// first blocks of the chain; just remember the result for each tip.
+unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consensus::Params& params) {
+    if (!pindexLast || !pindexLast->phashBlock)
+        return DarkGravityWaveUncached(pindexLast, params);
+
+    {
+        LOCK(cs_difficultycache);
+        for (unsigned int i = 0; i < DIFFICULTY_CACHE_SIZE; i++) {
+            const CDgwResult& entry = dgwCache[i];
+            if (IsCached(entry.pindexLast, entry.hashLast, pindexLast) &&
+                entry.powLimit == params.powLimit && entry.nPowTargetSpacing == params.nPowTargetSpacing)
+                return entry.nBits;
+        }
+    }
+
+    unsigned int nBits = DarkGravityWaveUncached(pindexLast, params);
+
+    LOCK(cs_difficultycache);
+    CDgwResult& entry = dgwCache[nDgwCacheNext++ % DIFFICULTY_CACHE_SIZE];
+    entry.pindexLast = pindexLast;
+    entry.hashLast = *pindexLast->phashBlock;
+    entry.powLimit = params.powLimit;
+    entry.nPowTargetSpacing = params.nPowTargetSpacing;
+    entry.nBits = nBits;
+    return nBits;
+}
+
 unsigned int GetNextWorkRequiredBTC(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
@@ -128,6 +220,104 @@ unsigned int LwmaGetNextWorkRequired(const CBlockIndex* pindexLast, const CBlock
     return LwmaCalculateNextWorkRequired(pindexLast, params);
 }
 
+static int64_t LwmaSolvetime(const CBlockIndex* block, int64_t T)
+{
+    int64_t solvetime = block->GetBlockTime() - block->pprev->GetBlockTime();
+
+    if (solvetime > 7 * T) {
+        solvetime = 7 * T;
+    }
+    if (solvetime < -(7 * T)) {
+        solvetime = -(7 * T);
+    }
+    return solvetime;
+}
+
+// Loop through N most recent blocks.
+static void LwmaWindowFull(const CBlockIndex* pindexLast, int64_t T, int64_t N, int64_t k, CLwmaWindow& window)
+{
+    const int height = pindexLast->nHeight + 1;
+    int j = 0;
+    for (int i = height - N; i < height; i++) {
+        const CBlockIndex* block = pindexLast->GetAncestor(i);
+        int64_t solvetime = LwmaSolvetime(block, T);
+
+        j++;
+        window.nWeightedSolvetime += solvetime * j;
+        window.nSolvetime += solvetime;
+
+        arith_uint256 target;
+        target.SetCompact(block->nBits);
+        window.sumTarget += target / (k * N * N);
+    }
+}
+
+// Window of pindexLast from the one of its parent: the oldest block drops out,
+// every remaining solvetime loses one weight and pindexLast comes in with
+// weight N. All sums are integer, so this is exact.
+static void LwmaWindowSlide(const CBlockIndex* pindexLast, const CLwmaWindow& windowPrev, CLwmaWindow& window)
+{
+    const int64_t T = windowPrev.T, N = windowPrev.N, k = windowPrev.k;
+    const CBlockIndex* pindexDrop = pindexLast->GetAncestor(pindexLast->nHeight - N);
+    int64_t solvetimeDrop = LwmaSolvetime(pindexDrop, T);
+    int64_t solvetimeNew = LwmaSolvetime(pindexLast, T);
+
+    window.nWeightedSolvetime = windowPrev.nWeightedSolvetime - windowPrev.nSolvetime + N * solvetimeNew;
+    window.nSolvetime = windowPrev.nSolvetime - solvetimeDrop + solvetimeNew;
+
+    arith_uint256 targetDrop, targetNew;
+    targetDrop.SetCompact(pindexDrop->nBits);
+    targetNew.SetCompact(pindexLast->nBits);
+    window.sumTarget = windowPrev.sumTarget - targetDrop / (k * N * N) + targetNew / (k * N * N);
+}
+
+static void GetLwmaWindow(const CBlockIndex* pindexLast, int64_t T, int64_t N, int64_t k, CLwmaWindow& window)
+{
+    window.T = T;
+    window.N = N;
+    window.k = k;
+
+    if (!pindexLast->phashBlock) {
+        LwmaWindowFull(pindexLast, T, N, k, window);
+        return;
+    }
+
+    bool fSlid = false;
+    {
+        LOCK(cs_difficultycache);
+        for (unsigned int i = 0; i < DIFFICULTY_CACHE_SIZE; i++) {
+            const CLwmaWindow& entry = lwmaCache[i];
+            if (entry.T != T || entry.N != N || entry.k != k)
+                continue;
+            if (IsCached(entry.pindexLast, entry.hashLast, pindexLast)) {
+                window = entry;
+                return;
+            }
+        }
+        // The parent's window only has the same length if it was full too
+        if (pindexLast->nHeight > N) {
+            for (unsigned int i = 0; i < DIFFICULTY_CACHE_SIZE; i++) {
+                const CLwmaWindow& entry = lwmaCache[i];
+                if (entry.T == T && entry.N == N && entry.k == k &&
+                    IsCached(entry.pindexLast, entry.hashLast, pindexLast->pprev)) {
+                    LwmaWindowSlide(pindexLast, entry, window);
+                    fSlid = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!fSlid)
+        LwmaWindowFull(pindexLast, T, N, k, window);
+
+    window.pindexLast = pindexLast;
+    window.hashLast = *pindexLast->phashBlock;
+
+    LOCK(cs_difficultycache);
+    lwmaCache[nLwmaCacheNext++ % DIFFICULTY_CACHE_SIZE] = window;
+}
+
 unsigned int LwmaCalculateNextWorkRequired(const CBlockIndex* pindexLast, const Consensus::Params& params)
 {
     if (params.fPowNoRetargeting) {
@@ -145,29 +335,11 @@ unsigned int LwmaCalculateNextWorkRequired(const CBlockIndex* pindexLast, const
 
     assert(height > N);
 
-    arith_uint256 sum_target;
-    int t = 0, j = 0;
+    CLwmaWindow window;
+    GetLwmaWindow(pindexLast, T, N, k, window);
+    int t = window.nWeightedSolvetime;
+    const arith_uint256& sum_target = window.sumTarget;
 
-    // Loop through N most recent blocks.
-    for (int i = height - N; i < height; i++) {
-        const CBlockIndex* block = pindexLast->GetAncestor(i);
-        const CBlockIndex* block_Prev = block->GetAncestor(i - 1);
-        int64_t solvetime = block->GetBlockTime() - block_Prev->GetBlockTime();
-
-        if (solvetime > 7 * T) {
-    	    solvetime = 7 * T; 
-    	}
-    	if (solvetime < -(7 * T)) {
-    	    solvetime = -(7 * T);
-    	}
-
-        j++;
-        t +=  solvetime * j;
-
-        arith_uint256 target;
-        target.SetCompact(block->nBits);
-        sum_target += target / (k * N * N);
-    }
     // Keep t reasonable in case strange solvetimes occurred.
     // if (t < N * k / 3) {
     //     t = N * k / 3;
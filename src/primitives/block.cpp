@@ -10,11 +10,29 @@
 #include "utilstrencodings.h"
 #include "crypto/common.h"
 
+#include <stddef.h>
+
 uint256 CBlockHeader::GetHash() const
 {
     return HashX16R(BEGIN(nVersion), END(nNonce), hashPrevBlock);
 }
 
+static_assert(offsetof(CBlockHeader, nNonce) + sizeof(uint32_t) - offsetof(CBlockHeader, nVersion) == sizeof(CBlock::vchHashCached),
+              "the header fields must be the 80 contiguous bytes that are hashed");
+
+uint256 CBlock::GetHash() const
+{
+    if (!hashCached.IsNull() && memcmp(BEGIN(nVersion), vchHashCached, sizeof(vchHashCached)) == 0)
+        return hashCached;
+    return CBlockHeader::GetHash();
+}
+
+void CBlock::SetCachedHash(const uint256& hash)
+{
+    hashCached = hash;
+    memcpy(vchHashCached, BEGIN(nVersion), sizeof(vchHashCached));
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -27,7 +45,7 @@ std::string CBlock::ToString() const
         vtx.size());
     for (unsigned int i = 0; i < vtx.size(); i++)
     {
-        s << "  " << vtx[i].ToString() << "\n";
+        s << "  " << vtx[i]->ToString() << "\n";
     }
     return s.str();
 }
@@ -74,12 +74,14 @@ class CBlock : public CBlockHeader
 {
 public:
     // network and disk
-    std::vector<CTransaction> vtx;
+    std::vector<CTransactionRef> vtx;
 
     // memory only
     mutable CTxOut txoutMasternode; // masternode payment
     mutable std::vector<CTxOut> voutSuperblock; // superblock payment
     mutable bool fChecked;
+    uint256 hashCached; //!< X16R hash of the header, see SetCachedHash()
+    unsigned char vchHashCached[80]; //!< header bytes hashCached belongs to
 
     CBlock()
     {
@@ -107,8 +109,21 @@ public:
         txoutMasternode = CTxOut();
         voutSuperblock.clear();
         fChecked = false;
+        hashCached.SetNull();
+        memset(vchHashCached, 0, sizeof(vchHashCached));
     }
 
+    /** X16R hash of the header. Returns the memo while the header fields still
+     *  match the bytes it was set for, so mutating any of them (e.g. nNonce while
+     *  mining) invalidates it. Never writes the memo, so a block shared between
+     *  threads can be hashed concurrently. */
+    uint256 GetHash() const;
+
+    /** Memoize the hash. Only for the owner of a block not shared with other
+     *  threads yet, e.g. right after reading or receiving it. */
+    void SetCachedHash(const uint256& hash);
+    void CacheHash() { SetCachedHash(CBlockHeader::GetHash()); }
+
     CBlockHeader GetBlockHeader() const
     {
         CBlockHeader block;
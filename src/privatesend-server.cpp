@@ -14,8 +14,15 @@
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include <univalue.h>
+
 CPrivateSendServer privateSendServer;
 
+bool CPrivateSendSession::HasParticipant(const CService& addr) const
+{
+    return std::find(vecSessionAddrs.begin(), vecSessionAddrs.end(), addr) != vecSessionAddrs.end();
+}
+
 void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if(!fMasterNode) return;
@@ -26,14 +33,7 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrintf("DSACCEPT -- incompatible version! nVersion: %d\n", pfrom->nVersion);
-            PushStatus(pfrom, STATUS_REJECTED, ERR_VERSION, connman);
-            return;
-        }
-
-        if(IsSessionReady()) {
-            // too many users in this session already, reject new ones
-            LogPrintf("DSACCEPT -- queue is already full!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, ERR_QUEUE_FULL, connman);
+            PushStatus(pfrom, NULL, STATUS_REJECTED, ERR_VERSION, connman);
             return;
         }
 
@@ -43,31 +43,61 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         LogPrint("privatesend", "DSACCEPT -- nDenom %d (%s)  txCollateral %s", nDenom, CPrivateSend::GetDenominationsToString(nDenom), txCollateral.ToString());
 
-        masternode_info_t mnInfo;
-        if(!mnodeman.GetMasternodeInfo(activeMasternode.outpoint, mnInfo)) {
-            PushStatus(pfrom, STATUS_REJECTED, ERR_MN_LIST, connman);
+        LOCK(cs_darksend);
+
+        if(GetSessionByAddr(pfrom->addr)) {
+            LogPrintf("DSACCEPT -- already in a session: addr=%s\n", pfrom->addr.ToString());
+            PushStatus(pfrom, GetSessionByAddr(pfrom->addr), STATUS_REJECTED, ERR_MODE, connman);
             return;
         }
 
-        if(vecSessionCollaterals.size() == 0 && mnInfo.nLastDsq != 0 &&
-            mnInfo.nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5 > mnodeman.nDsqCount)
-        {
-            LogPrintf("DSACCEPT -- last dsq too recent, must wait: addr=%s\n", pfrom->addr.ToString());
-            PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
+        // Older clients act on the ready queue of any session on this
+        // masternode, so they only mix while no other session is running
+        bool fLegacy = pfrom->nVersion < PRIVATESEND_SESSIONS_VERSION;
+        CPrivateSendSession* psession = GetSessionByDenom(nDenom);
+        if(psession && fLegacy && mapSessions.size() > 1) psession = NULL;
+
+        if(psession && psession->IsReady()) {
+            // too many users in this session already, reject new ones
+            LogPrintf("DSACCEPT -- queue is already full!\n");
+            PushStatus(pfrom, psession, STATUS_ACCEPTED, ERR_QUEUE_FULL, connman);
             return;
         }
 
+        if(!psession) {
+            if((int)mapSessions.size() >= nMaxSessions || (fLegacy && !mapSessions.empty()) || HasLegacySession()) {
+                LogPrintf("DSACCEPT -- no free session slot: sessions=%d, legacy client=%d\n", mapSessions.size(), fLegacy);
+                PushStatus(pfrom, NULL, STATUS_ACCEPTED, ERR_QUEUE_FULL, connman);
+                return;
+            }
+
+            masternode_info_t mnInfo;
+            if(!mnodeman.GetMasternodeInfo(activeMasternode.outpoint, mnInfo)) {
+                PushStatus(pfrom, NULL, STATUS_REJECTED, ERR_MN_LIST, connman);
+                return;
+            }
+
+            // the rate limit is per masternode, not per session: only the first session has to wait for it
+            if(mapSessions.empty() && mnInfo.nLastDsq != 0 &&
+                mnInfo.nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5 > mnodeman.nDsqCount)
+            {
+                LogPrintf("DSACCEPT -- last dsq too recent, must wait: addr=%s\n", pfrom->addr.ToString());
+                PushStatus(pfrom, NULL, STATUS_REJECTED, ERR_RECENT, connman);
+                return;
+            }
+        }
+
         PoolMessage nMessageID = MSG_NOERR;
 
-        bool fResult = nSessionID == 0  ? CreateNewSession(nDenom, txCollateral, nMessageID, connman)
-                                        : AddUserToExistingSession(nDenom, txCollateral, nMessageID);
+        bool fResult = psession == NULL ? CreateNewSession(nDenom, txCollateral, pfrom->addr, fLegacy, nMessageID, connman)
+                                        : AddUserToExistingSession(*psession, nDenom, txCollateral, pfrom->addr, fLegacy, nMessageID);
         if(fResult) {
             LogPrintf("DSACCEPT -- is compatible, please submit!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
+            PushStatus(pfrom, GetSessionByAddr(pfrom->addr), STATUS_ACCEPTED, nMessageID, connman);
             return;
         } else {
             LogPrintf("DSACCEPT -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
+            PushStatus(pfrom, psession, STATUS_REJECTED, nMessageID, connman);
             return;
         }
 
@@ -106,8 +136,8 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         if(!dsq.fReady) {
             BOOST_FOREACH(CDarksendQueue q, vecDarksendQueue) {
-                if(q.vin == dsq.vin) {
-                    // no way same mn can send another "not yet ready" dsq this soon
+                if(q.vin == dsq.vin && q.nDenom == dsq.nDenom) {
+                    // no way same mn can send another "not yet ready" dsq for the same session this soon
                     LogPrint("privatesend", "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", mnInfo.addr.ToString());
                     return;
                 }
@@ -115,8 +145,8 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
             int nThreshold = mnInfo.nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5;
             LogPrint("privatesend", "DSQUEUE -- nLastDsq: %d  threshold: %d  nDsqCount: %d\n", mnInfo.nLastDsq, nThreshold, mnodeman.nDsqCount);
-            //don't allow a few nodes to dominate the queuing process
-            if(mnInfo.nLastDsq != 0 && nThreshold > mnodeman.nDsqCount) {
+            //don't allow a few nodes to dominate the queuing process, further sessions of a mixing masternode are fine
+            if(mnInfo.nLastDsq != 0 && nThreshold > mnodeman.nDsqCount && !HasQueueFromMasternode(dsq.vin.prevout)) {
                 LogPrint("privatesend", "DSQUEUE -- Masternode %s is sending too many dsq messages\n", mnInfo.addr.ToString());
                 return;
             }
@@ -131,16 +161,21 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrintf("DSVIN -- incompatible version! nVersion: %d\n", pfrom->nVersion);
-            PushStatus(pfrom, STATUS_REJECTED, ERR_VERSION, connman);
+            PushStatus(pfrom, NULL, STATUS_REJECTED, ERR_VERSION, connman);
             return;
         }
 
+        LOCK(cs_darksend);
+
+        CPrivateSendSession* psession = GetSessionByAddr(pfrom->addr);
+
         //do we have enough users in the current session?
-        if(!IsSessionReady()) {
+        if(!psession || !psession->IsReady()) {
             LogPrintf("DSVIN -- session not complete!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_SESSION, connman);
+            PushStatus(pfrom, psession, STATUS_REJECTED, ERR_SESSION, connman);
             return;
         }
+        CPrivateSendSession& session = *psession;
 
         CDarkSendEntry entry;
         vRecv >> entry;
@@ -149,20 +184,20 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         if(entry.vecTxDSIn.size() > PRIVATESEND_ENTRY_MAX_SIZE) {
             LogPrintf("DSVIN -- ERROR: too many inputs! %d/%d\n", entry.vecTxDSIn.size(), PRIVATESEND_ENTRY_MAX_SIZE);
-            PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, connman);
+            PushStatus(pfrom, &session, STATUS_REJECTED, ERR_MAXIMUM, connman);
             return;
         }
 
         if(entry.vecTxOut.size() > PRIVATESEND_ENTRY_MAX_SIZE) {
             LogPrintf("DSVIN -- ERROR: too many outputs! %d/%d\n", entry.vecTxOut.size(), PRIVATESEND_ENTRY_MAX_SIZE);
-            PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, connman);
+            PushStatus(pfrom, &session, STATUS_REJECTED, ERR_MAXIMUM, connman);
             return;
         }
 
         //do we have the same denominations as the current session?
-        if(!IsOutputsCompatibleWithSessionDenom(entry.vecTxOut)) {
+        if(!IsOutputsCompatibleWithSessionDenom(session, entry.vecTxOut)) {
             LogPrintf("DSVIN -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_EXISTING_TX, connman);
+            PushStatus(pfrom, &session, STATUS_REJECTED, ERR_EXISTING_TX, connman);
             return;
         }
 
@@ -179,12 +214,12 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
                 if(txout.scriptPubKey.size() != 25) {
                     LogPrintf("DSVIN -- non-standard pubkey detected! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY, connman);
+                    PushStatus(pfrom, &session, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY, connman);
                     return;
                 }
                 if(!txout.scriptPubKey.IsPayToPublicKeyHash()) {
                     LogPrintf("DSVIN -- invalid script! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT, connman);
+                    PushStatus(pfrom, &session, STATUS_REJECTED, ERR_INVALID_SCRIPT, connman);
                     return;
                 }
             }
@@ -199,7 +234,7 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
                     nValueIn += coin.out.nValue;
                 } else {
                     LogPrintf("DSVIN -- missing input! tx=%s", tx.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX, connman);
+                    PushStatus(pfrom, &session, STATUS_REJECTED, ERR_MISSING_TX, connman);
                     return;
                 }
             }
@@ -208,7 +243,7 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             CAmount nFee = nValueIn - nValueOut;
             if(nFee != 0) {
                 LogPrintf("DSVIN -- there should be no fee in mixing tx! fees: %lld, tx=%s", nFee, tx.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_FEES, connman);
+                PushStatus(pfrom, &session, STATUS_REJECTED, ERR_FEES, connman);
                 return;
             }
 
@@ -216,9 +251,9 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
                 LOCK(cs_main);
                 CValidationState validationState;
                 mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), 1000, 0.1*COIN);
-                if(!AcceptToMemoryPool(mempool, validationState, CTransaction(tx), false, NULL, false, true, true)) {
+                if(!AcceptToMemoryPool(mempool, validationState, MakeTransactionRef(tx), false, NULL, false, true, true)) {
                     LogPrintf("DSVIN -- transaction not valid! tx=%s", tx.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_TX, connman);
+                    PushStatus(pfrom, &session, STATUS_REJECTED, ERR_INVALID_TX, connman);
                     return;
                 }
             }
@@ -227,14 +262,17 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
         PoolMessage nMessageID = MSG_NOERR;
 
         entry.addr = pfrom->addr;
-        if(AddEntry(entry, nMessageID)) {
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
-            CheckPool(connman);
-            RelayStatus(STATUS_ACCEPTED, connman);
+        if(AddEntry(session, entry, nMessageID)) {
+            PushStatus(pfrom, &session, STATUS_ACCEPTED, nMessageID, connman);
+            CheckPool(session, connman);
+            if(session.nState != POOL_STATE_IDLE) RelayStatus(session, STATUS_ACCEPTED, connman);
         } else {
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
-            SetNull();
+            // Only this entry is rejected, like the checks above, the other
+            // participants keep their session. If the peer never sends a valid
+            // entry, ChargeFees() counts it as an offender on timeout.
+            PushStatus(pfrom, &session, STATUS_REJECTED, nMessageID, connman);
         }
+        RemoveIdleSessions();
 
     } else if(strCommand == NetMsgType::DSSIGNFINALTX) {
 
@@ -248,95 +286,192 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         LogPrint("privatesend", "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
+        LOCK(cs_darksend);
+
+        CPrivateSendSession* psession = GetSessionByAddr(pfrom->addr);
+        if(!psession || psession->nState != POOL_STATE_SIGNING) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- no session is signing for %s\n", pfrom->addr.ToString());
+            return;
+        }
+        CPrivateSendSession& session = *psession;
+
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
         BOOST_FOREACH(const CTxIn txin, vecTxIn) {
             nTxInIndex++;
-            if(!AddScriptSig(txin)) {
-                LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED, connman);
+            if(!AddScriptSig(session, txin)) {
+                LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, session.nSessionID);
+                RelayStatus(session, STATUS_REJECTED, connman);
+                RemoveIdleSessions();
                 return;
             }
             LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
         }
         // all is good
-        CheckPool(connman);
+        CheckPool(session, connman);
+        RemoveIdleSessions();
     }
 }
 
 void CPrivateSendServer::SetNull()
 {
     // MN side
-    vecSessionCollaterals.clear();
+    mapSessions.clear();
 
     CPrivateSendBase::SetNull();
 }
 
+CPrivateSendSession* CPrivateSendServer::GetSessionByAddr(const CService& addr)
+{
+    for (auto& pair : mapSessions) {
+        if(pair.second.HasParticipant(addr)) return &pair.second;
+    }
+    return NULL;
+}
+
+CPrivateSendSession* CPrivateSendServer::GetSessionByDenom(int nDenom)
+{
+    for (auto& pair : mapSessions) {
+        if(pair.second.nSessionDenom == nDenom) return &pair.second;
+    }
+    return NULL;
+}
+
+bool CPrivateSendServer::HasLegacySession() const
+{
+    for (const auto& pair : mapSessions) {
+        if(pair.second.fLegacy) return true;
+    }
+    return false;
+}
+
+void CPrivateSendServer::RemoveIdleSessions()
+{
+    std::map<int, CPrivateSendSession>::iterator it = mapSessions.begin();
+    while(it != mapSessions.end()) {
+        if(it->second.nState == POOL_STATE_IDLE) {
+            LogPrint("privatesend", "CPrivateSendServer::%s -- removing session %d\n", __func__, it->first);
+            mapSessions.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CPrivateSendServer::EndSession(CPrivateSendSession& session, bool fSuccess)
+{
+    if(session.nState == POOL_STATE_IDLE) return; // already ended
+
+    (fSuccess ? dequeSessionsCompleted : dequeSessionsFailed).push_back(GetTime());
+    PruneSessionStats();
+
+    session.nState = POOL_STATE_IDLE;
+    session.vecEntries.clear();
+    session.vecSessionCollaterals.clear();
+    session.vecSessionAddrs.clear();
+}
+
+void CPrivateSendServer::PruneSessionStats()
+{
+    int64_t nTimeCutoff = GetTime() - 60 * 60;
+    while(!dequeSessionsCompleted.empty() && dequeSessionsCompleted.front() < nTimeCutoff)
+        dequeSessionsCompleted.pop_front();
+    while(!dequeSessionsFailed.empty() && dequeSessionsFailed.front() < nTimeCutoff)
+        dequeSessionsFailed.pop_front();
+}
+
+UniValue CPrivateSendServer::GetSessionsInfo()
+{
+    LOCK(cs_darksend);
+    PruneSessionStats();
+
+    UniValue arrSessions(UniValue::VARR);
+    int nEntries = 0;
+    PoolState nStateMax = POOL_STATE_IDLE; // the most advanced session
+    for (const auto& pair : mapSessions) {
+        const CPrivateSendSession& session = pair.second;
+        if(session.nState > nStateMax) nStateMax = session.nState;
+        UniValue objSession(UniValue::VOBJ);
+        objSession.push_back(Pair("session",        session.nSessionID));
+        objSession.push_back(Pair("denom",          CPrivateSend::GetDenominationsToString(session.nSessionDenom)));
+        objSession.push_back(Pair("state",          GetStateString(session.nState)));
+        objSession.push_back(Pair("participants",   (int)session.vecSessionCollaterals.size()));
+        objSession.push_back(Pair("entries",        session.GetEntriesCount()));
+        objSession.push_back(Pair("idle_time",      (GetTimeMillis() - session.nTimeLastSuccessfulStep) / 1000));
+        arrSessions.push_back(objSession);
+        nEntries += session.GetEntriesCount();
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("state",                 GetStateString(nStateMax)));
+    obj.push_back(Pair("queue",                 GetQueueSize()));
+    obj.push_back(Pair("entries",               nEntries));
+    obj.push_back(Pair("sessions_max",          nMaxSessions));
+    obj.push_back(Pair("sessions",              arrSessions));
+    obj.push_back(Pair("sessions_per_hour",     (int)dequeSessionsCompleted.size()));
+    obj.push_back(Pair("failed_per_hour",       (int)dequeSessionsFailed.size()));
+    return obj;
+}
+
 //
 // Check the mixing progress and send client updates if a Masternode
 //
-void CPrivateSendServer::CheckPool(CConnman& connman)
+void CPrivateSendServer::CheckPool(CPrivateSendSession& session, CConnman& connman)
 {
     if(fMasterNode) {
-        LogPrint("privatesend", "CPrivateSendServer::CheckPool -- entries count %lu\n", GetEntriesCount());
+        LogPrint("privatesend", "CPrivateSendServer::CheckPool -- session %d, entries count %lu\n", session.nSessionID, session.GetEntriesCount());
 
         // If entries are full, create finalized transaction
-        if(nState == POOL_STATE_ACCEPTING_ENTRIES && GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
+        if(session.nState == POOL_STATE_ACCEPTING_ENTRIES && session.GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
             LogPrint("privatesend", "CPrivateSendServer::CheckPool -- FINALIZE TRANSACTIONS\n");
-            CreateFinalTransaction(connman);
+            CreateFinalTransaction(session, connman);
             return;
         }
 
         // If we have all of the signatures, try to compile the transaction
-        if(nState == POOL_STATE_SIGNING && IsSignaturesComplete()) {
+        if(session.nState == POOL_STATE_SIGNING && IsSignaturesComplete(session)) {
             LogPrint("privatesend", "CPrivateSendServer::CheckPool -- SIGNING\n");
-            CommitFinalTransaction(connman);
+            CommitFinalTransaction(session, connman);
             return;
         }
     }
-
-    // reset if we're here for 10 seconds
-    if((nState == POOL_STATE_ERROR || nState == POOL_STATE_SUCCESS) && GetTimeMillis() - nTimeLastSuccessfulStep >= 10000) {
-        LogPrint("privatesend", "CPrivateSendServer::CheckPool -- timeout, RESETTING\n");
-        SetNull();
-    }
 }
 
-void CPrivateSendServer::CreateFinalTransaction(CConnman& connman)
+void CPrivateSendServer::CreateFinalTransaction(CPrivateSendSession& session, CConnman& connman)
 {
     LogPrint("privatesend", "CPrivateSendServer::CreateFinalTransaction -- FINALIZE TRANSACTIONS\n");
 
     CMutableTransaction txNew;
 
     // make our new transaction
-    for(int i = 0; i < GetEntriesCount(); i++) {
-        for (const auto& txout : vecEntries[i].vecTxOut)
+    for(int i = 0; i < session.GetEntriesCount(); i++) {
+        for (const auto& txout : session.vecEntries[i].vecTxOut)
             txNew.vout.push_back(txout);
 
-        BOOST_FOREACH(const CTxDSIn& txdsin, vecEntries[i].vecTxDSIn)
+        BOOST_FOREACH(const CTxDSIn& txdsin, session.vecEntries[i].vecTxDSIn)
             txNew.vin.push_back(txdsin);
     }
 
     sort(txNew.vin.begin(), txNew.vin.end(), CompareInputBIP69());
     sort(txNew.vout.begin(), txNew.vout.end(), CompareOutputBIP69());
 
-    finalMutableTransaction = txNew;
-    LogPrint("privatesend", "CPrivateSendServer::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString());
+    session.finalMutableTransaction = txNew;
+    LogPrint("privatesend", "CPrivateSendServer::CreateFinalTransaction -- session %d, finalMutableTransaction=%s", session.nSessionID, txNew.ToString());
 
     // request signatures from clients
-    RelayFinalTransaction(finalMutableTransaction, connman);
-    SetState(POOL_STATE_SIGNING);
+    SetState(session, POOL_STATE_SIGNING);
+    RelayFinalTransaction(session, session.finalMutableTransaction, connman);
 }
 
-void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
+void CPrivateSendServer::CommitFinalTransaction(CPrivateSendSession& session, CConnman& connman)
 {
     if(!fMasterNode) return; // check and relay final tx only on masternode
 
-    CTransaction finalTransaction = CTransaction(finalMutableTransaction);
-    uint256 hashTx = finalTransaction.GetHash();
+    CTransactionRef finalTransaction = MakeTransactionRef(session.finalMutableTransaction);
+    uint256 hashTx = finalTransaction->GetHash();
 
-    LogPrint("privatesend", "CPrivateSendServer::CommitFinalTransaction -- finalTransaction=%s", finalTransaction.ToString());
+    LogPrint("privatesend", "CPrivateSendServer::CommitFinalTransaction -- finalTransaction=%s", finalTransaction->ToString());
 
     {
         // See if the transaction is valid
@@ -346,9 +481,9 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
         if(!lockMain || !AcceptToMemoryPool(mempool, validationState, finalTransaction, false, NULL, false, true, true))
         {
             LogPrintf("CPrivateSendServer::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
-            SetNull();
             // not much we can do in this case, just notify clients
-            RelayCompletedTransaction(ERR_INVALID_TX, connman);
+            RelayCompletedTransaction(session, ERR_INVALID_TX, connman);
+            EndSession(session, false);
             return;
         }
     }
@@ -368,14 +503,14 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
     connman.RelayInv(inv);
 
     // Tell the clients it was successful
-    RelayCompletedTransaction(MSG_SUCCESS, connman);
+    RelayCompletedTransaction(session, MSG_SUCCESS, connman);
 
     // Randomly charge clients
-    ChargeRandomFees(connman);
+    ChargeRandomFees(session, connman);
 
     // Reset
-    LogPrint("privatesend", "CPrivateSendServer::CommitFinalTransaction -- COMPLETED -- RESETTING\n");
-    SetNull();
+    LogPrint("privatesend", "CPrivateSendServer::CommitFinalTransaction -- session %d COMPLETED -- RESETTING\n", session.nSessionID);
+    EndSession(session, true);
 }
 
 //
@@ -390,7 +525,7 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
 // transaction for the client to be able to enter the pool. This transaction is kept by the Masternode
 // until the transaction is either complete or fails.
 //
-void CPrivateSendServer::ChargeFees(CConnman& connman)
+void CPrivateSendServer::ChargeFees(const CPrivateSendSession& session, CConnman& connman)
 {
     if(!fMasterNode) return;
 
@@ -399,10 +534,10 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
 
     std::vector<CTransaction> vecOffendersCollaterals;
 
-    if(nState == POOL_STATE_ACCEPTING_ENTRIES) {
-        BOOST_FOREACH(const CTransaction& txCollateral, vecSessionCollaterals) {
+    if(session.nState == POOL_STATE_ACCEPTING_ENTRIES) {
+        BOOST_FOREACH(const CTransaction& txCollateral, session.vecSessionCollaterals) {
             bool fFound = false;
-            BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries)
+            BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries)
                 if(entry.txCollateral == txCollateral)
                     fFound = true;
 
@@ -414,9 +549,9 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
         }
     }
 
-    if(nState == POOL_STATE_SIGNING) {
+    if(session.nState == POOL_STATE_SIGNING) {
         // who didn't sign?
-        BOOST_FOREACH(const CDarkSendEntry entry, vecEntries) {
+        BOOST_FOREACH(const CDarkSendEntry entry, session.vecEntries) {
             BOOST_FOREACH(const CTxDSIn txdsin, entry.vecTxDSIn) {
                 if(!txdsin.fHasSig) {
                     LogPrintf("CPrivateSendServer::ChargeFees -- found uncooperative node (didn't sign), found offence\n");
@@ -438,15 +573,15 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
     //charge one of the offenders randomly
     std::random_shuffle(vecOffendersCollaterals.begin(), vecOffendersCollaterals.end());
 
-    if(nState == POOL_STATE_ACCEPTING_ENTRIES || nState == POOL_STATE_SIGNING) {
+    if(session.nState == POOL_STATE_ACCEPTING_ENTRIES || session.nState == POOL_STATE_SIGNING) {
         LogPrintf("CPrivateSendServer::ChargeFees -- found uncooperative node (didn't %s transaction), charging fees: %s\n",
-                (nState == POOL_STATE_SIGNING) ? "sign" : "send", vecOffendersCollaterals[0].ToString());
+                (session.nState == POOL_STATE_SIGNING) ? "sign" : "send", vecOffendersCollaterals[0].ToString());
 
         LOCK(cs_main);
 
         CValidationState state;
         bool fMissingInputs;
-        if(!AcceptToMemoryPool(mempool, state, vecOffendersCollaterals[0], false, &fMissingInputs, false, true)) {
+        if(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(vecOffendersCollaterals[0]), false, &fMissingInputs, false, true)) {
             // should never really happen
             LogPrintf("CPrivateSendServer::ChargeFees -- ERROR: AcceptToMemoryPool failed!\n");
         } else {
@@ -467,13 +602,13 @@ void CPrivateSendServer::ChargeFees(CConnman& connman)
     stop these kinds of attacks 1 in 10 successful transactions are charged. This
     adds up to a cost of 0.001DRK per transaction on average.
 */
-void CPrivateSendServer::ChargeRandomFees(CConnman& connman)
+void CPrivateSendServer::ChargeRandomFees(const CPrivateSendSession& session, CConnman& connman)
 {
     if(!fMasterNode) return;
 
     LOCK(cs_main);
 
-    BOOST_FOREACH(const CTransaction& txCollateral, vecSessionCollaterals) {
+    BOOST_FOREACH(const CTransaction& txCollateral, session.vecSessionCollaterals) {
 
         if(GetRandInt(100) > 10) return;
 
@@ -481,7 +616,7 @@ void CPrivateSendServer::ChargeRandomFees(CConnman& connman)
 
         CValidationState state;
         bool fMissingInputs;
-        if(!AcceptToMemoryPool(mempool, state, txCollateral, false, &fMissingInputs, false, true)) {
+        if(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(txCollateral), false, &fMissingInputs, false, true)) {
             // should never really happen
             LogPrintf("CPrivateSendServer::ChargeRandomFees -- ERROR: AcceptToMemoryPool failed!\n");
         } else {
@@ -499,17 +634,21 @@ void CPrivateSendServer::CheckTimeout(CConnman& connman)
 
     if(!fMasterNode) return;
 
-    int nLagTime = fMasterNode ? 0 : 10000; // if we're the client, give the server a few extra seconds before resetting.
-    int nTimeout = (nState == POOL_STATE_SIGNING) ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT;
-    bool fTimeout = GetTimeMillis() - nTimeLastSuccessfulStep >= nTimeout*1000 + nLagTime;
+    LOCK(cs_darksend);
 
-    if(nState != POOL_STATE_IDLE && fTimeout) {
-        LogPrint("privatesend", "CPrivateSendServer::CheckTimeout -- %s timed out (%ds) -- restting\n",
-                (nState == POOL_STATE_SIGNING) ? "Signing" : "Session", nTimeout);
-        ChargeFees(connman);
-        SetNull();
-        SetState(POOL_STATE_ERROR);
+    for (auto& pair : mapSessions) {
+        CPrivateSendSession& session = pair.second;
+        int nTimeout = (session.nState == POOL_STATE_SIGNING) ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT;
+        bool fTimeout = GetTimeMillis() - session.nTimeLastSuccessfulStep >= nTimeout*1000;
+
+        if(session.nState != POOL_STATE_IDLE && fTimeout) {
+            LogPrint("privatesend", "CPrivateSendServer::CheckTimeout -- %s %d timed out (%ds) -- restting\n",
+                    (session.nState == POOL_STATE_SIGNING) ? "Signing" : "Session", session.nSessionID, nTimeout);
+            ChargeFees(session, connman);
+            EndSession(session, false);
+        }
     }
+    RemoveIdleSessions();
 }
 
 /*
@@ -521,18 +660,23 @@ void CPrivateSendServer::CheckForCompleteQueue(CConnman& connman)
 {
     if(!fMasterNode) return;
 
-    if(nState == POOL_STATE_QUEUE && IsSessionReady()) {
-        SetState(POOL_STATE_ACCEPTING_ENTRIES);
+    LOCK(cs_darksend);
 
-        CDarksendQueue dsq(nSessionDenom, activeMasternode.outpoint, GetAdjustedTime(), true);
-        LogPrint("privatesend", "CPrivateSendServer::CheckForCompleteQueue -- queue is ready, signing and relaying (%s)\n", dsq.ToString());
-        dsq.Sign();
-        dsq.Relay(connman);
+    for (auto& pair : mapSessions) {
+        CPrivateSendSession& session = pair.second;
+        if(session.nState == POOL_STATE_QUEUE && session.IsReady()) {
+            SetState(session, POOL_STATE_ACCEPTING_ENTRIES);
+
+            CDarksendQueue dsq(session.nSessionDenom, activeMasternode.outpoint, GetAdjustedTime(), true);
+            LogPrint("privatesend", "CPrivateSendServer::CheckForCompleteQueue -- session %d is ready, signing and relaying (%s)\n", session.nSessionID, dsq.ToString());
+            dsq.Sign();
+            dsq.Relay(connman);
+        }
     }
 }
 
 // Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
+bool CPrivateSendServer::IsInputScriptSigValid(const CPrivateSendSession& session, const CTxIn& txin)
 {
     CMutableTransaction txNew;
     txNew.vin.clear();
@@ -542,7 +686,7 @@ bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
     int nTxInIndex = -1;
     CScript sigPubKey = CScript();
 
-    BOOST_FOREACH(CDarkSendEntry& entry, vecEntries) {
+    BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries) {
 
         for (const auto& txout : entry.vecTxOut)
             txNew.vout.push_back(txout);
@@ -577,7 +721,7 @@ bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
 //
 // Add a clients transaction to the pool
 //
-bool CPrivateSendServer::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet)
+bool CPrivateSendServer::AddEntry(CPrivateSendSession& session, const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet)
 {
     if(!fMasterNode) return false;
 
@@ -595,7 +739,7 @@ bool CPrivateSendServer::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& n
         return false;
     }
 
-    if(GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
+    if(session.GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
         LogPrint("privatesend", "CPrivateSendServer::AddEntry -- entries is full!\n");
         nMessageIDRet = ERR_ENTRIES_FULL;
         return false;
@@ -603,31 +747,34 @@ bool CPrivateSendServer::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& n
 
     BOOST_FOREACH(CTxIn txin, entryNew.vecTxDSIn) {
         LogPrint("privatesend", "looking for txin -- %s\n", txin.ToString());
-        BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries) {
-            BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
-                if(txdsin.prevout == txin.prevout) {
-                    LogPrint("privatesend", "CPrivateSendServer::AddEntry -- found in txin\n");
-                    nMessageIDRet = ERR_ALREADY_HAVE;
-                    return false;
+        // inputs must not be reused in this or any other session
+        for (const auto& pair : mapSessions) {
+            BOOST_FOREACH(const CDarkSendEntry& entry, pair.second.vecEntries) {
+                BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
+                    if(txdsin.prevout == txin.prevout) {
+                        LogPrint("privatesend", "CPrivateSendServer::AddEntry -- found in txin of session %d\n", pair.first);
+                        nMessageIDRet = ERR_ALREADY_HAVE;
+                        return false;
+                    }
                 }
             }
         }
     }
 
-    vecEntries.push_back(entryNew);
+    session.vecEntries.push_back(entryNew);
 
-    LogPrint("privatesend", "CPrivateSendServer::AddEntry -- adding entry\n");
+    LogPrint("privatesend", "CPrivateSendServer::AddEntry -- adding entry to session %d\n", session.nSessionID);
     nMessageIDRet = MSG_ENTRIES_ADDED;
-    nTimeLastSuccessfulStep = GetTimeMillis();
+    session.nTimeLastSuccessfulStep = GetTimeMillis();
 
     return true;
 }
 
-bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
+bool CPrivateSendServer::AddScriptSig(CPrivateSendSession& session, const CTxIn& txinNew)
 {
     LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
 
-    BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries) {
+    BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries) {
         BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
             if(txdsin.scriptSig == txinNew.scriptSig) {
                 LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- already exists\n");
@@ -636,21 +783,21 @@ bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if(!IsInputScriptSigValid(txinNew)) {
+    if(!IsInputScriptSigValid(session, txinNew)) {
         LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- Invalid scriptSig\n");
         return false;
     }
 
     LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
 
-    BOOST_FOREACH(CTxIn& txin, finalMutableTransaction.vin) {
+    BOOST_FOREACH(CTxIn& txin, session.finalMutableTransaction.vin) {
         if(txinNew.prevout == txin.prevout && txin.nSequence == txinNew.nSequence) {
             txin.scriptSig = txinNew.scriptSig;
             LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
         }
     }
-    for(int i = 0; i < GetEntriesCount(); i++) {
-        if(vecEntries[i].AddScriptSig(txinNew)) {
+    for(int i = 0; i < session.GetEntriesCount(); i++) {
+        if(session.vecEntries[i].AddScriptSig(txinNew)) {
             LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- adding to entries, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
             return true;
         }
@@ -661,20 +808,20 @@ bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
 }
 
 // Check to make sure everything is signed
-bool CPrivateSendServer::IsSignaturesComplete()
+bool CPrivateSendServer::IsSignaturesComplete(const CPrivateSendSession& session)
 {
-    BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries)
+    BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries)
         BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn)
             if(!txdsin.fHasSig) return false;
 
     return true;
 }
 
-bool CPrivateSendServer::IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut)
+bool CPrivateSendServer::IsOutputsCompatibleWithSessionDenom(const CPrivateSendSession& session, const std::vector<CTxOut>& vecTxOut)
 {
     if(CPrivateSend::GetDenominations(vecTxOut) == 0) return false;
 
-    BOOST_FOREACH(const CDarkSendEntry entry, vecEntries) {
+    BOOST_FOREACH(const CDarkSendEntry entry, session.vecEntries) {
         LogPrintf("CPrivateSendServer::IsOutputsCompatibleWithSessionDenom -- vecTxOut denom %d, entry.vecTxOut denom %d\n",
                 CPrivateSend::GetDenominations(vecTxOut), CPrivateSend::GetDenominations(entry.vecTxOut));
         if(CPrivateSend::GetDenominations(vecTxOut) != CPrivateSend::GetDenominations(entry.vecTxOut)) return false;
@@ -705,14 +852,14 @@ bool CPrivateSendServer::IsAcceptableDenomAndCollateral(int nDenom, CTransaction
     return true;
 }
 
-bool CPrivateSendServer::CreateNewSession(int nDenom, CTransaction txCollateral, PoolMessage& nMessageIDRet, CConnman& connman)
+bool CPrivateSendServer::CreateNewSession(int nDenom, CTransaction txCollateral, const CService& addr, bool fLegacy, PoolMessage& nMessageIDRet, CConnman& connman)
 {
-    if(!fMasterNode || nSessionID != 0) return false;
+    if(!fMasterNode) return false;
 
-    // new session can only be started in idle mode
-    if(nState != POOL_STATE_IDLE) {
+    // only one session per denom, clients can't tell ready queues of the same denom apart
+    if(GetSessionByDenom(nDenom) != NULL) {
         nMessageIDRet = ERR_MODE;
-        LogPrintf("CPrivateSendServer::CreateNewSession -- incompatible mode: nState=%d\n", nState);
+        LogPrintf("CPrivateSendServer::CreateNewSession -- session for denom %d already exists\n", nDenom);
         return false;
     }
 
@@ -721,12 +868,17 @@ bool CPrivateSendServer::CreateNewSession(int nDenom, CTransaction txCollateral,
     }
 
     // start new session
+    int nSessionIDNew;
+    do {
+        nSessionIDNew = GetRandInt(999999)+1;
+    } while(mapSessions.count(nSessionIDNew));
+
     nMessageIDRet = MSG_NOERR;
-    nSessionID = GetRandInt(999999)+1;
-    nSessionDenom = nDenom;
+    CPrivateSendSession& session = mapSessions.emplace(nSessionIDNew, CPrivateSendSession(nSessionIDNew, nDenom)).first->second;
 
-    SetState(POOL_STATE_QUEUE);
-    nTimeLastSuccessfulStep = GetTimeMillis();
+    SetState(session, POOL_STATE_QUEUE);
+    session.nTimeLastSuccessfulStep = GetTimeMillis();
+    session.fLegacy = fLegacy;
 
     if(!fUnitTest) {
         //broadcast that I'm accepting entries, only if it's the first entry through
@@ -737,31 +889,32 @@ bool CPrivateSendServer::CreateNewSession(int nDenom, CTransaction txCollateral,
         vecDarksendQueue.push_back(dsq);
     }
 
-    vecSessionCollaterals.push_back(txCollateral);
-    LogPrintf("CPrivateSendServer::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
-            nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom), vecSessionCollaterals.size());
+    session.vecSessionCollaterals.push_back(txCollateral);
+    session.vecSessionAddrs.push_back(addr);
+    LogPrintf("CPrivateSendServer::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d  sessions: %d\n",
+            session.nSessionID, session.nSessionDenom, CPrivateSend::GetDenominationsToString(session.nSessionDenom), session.vecSessionCollaterals.size(), mapSessions.size());
 
     return true;
 }
 
-bool CPrivateSendServer::AddUserToExistingSession(int nDenom, CTransaction txCollateral, PoolMessage& nMessageIDRet)
+bool CPrivateSendServer::AddUserToExistingSession(CPrivateSendSession& session, int nDenom, CTransaction txCollateral, const CService& addr, bool fLegacy, PoolMessage& nMessageIDRet)
 {
-    if(!fMasterNode || nSessionID == 0 || IsSessionReady()) return false;
+    if(!fMasterNode || session.IsReady()) return false;
 
     if(!IsAcceptableDenomAndCollateral(nDenom, txCollateral, nMessageIDRet)) {
         return false;
     }
 
     // we only add new users to an existing session when we are in queue mode
-    if(nState != POOL_STATE_QUEUE) {
+    if(session.nState != POOL_STATE_QUEUE) {
         nMessageIDRet = ERR_MODE;
-        LogPrintf("CPrivateSendServer::AddUserToExistingSession -- incompatible mode: nState=%d\n", nState);
+        LogPrintf("CPrivateSendServer::AddUserToExistingSession -- incompatible mode: nState=%d\n", session.nState);
         return false;
     }
 
-    if(nDenom != nSessionDenom) {
+    if(nDenom != session.nSessionDenom) {
         LogPrintf("CPrivateSendServer::AddUserToExistingSession -- incompatible denom %d (%s) != nSessionDenom %d (%s)\n",
-                    nDenom, CPrivateSend::GetDenominationsToString(nDenom), nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
+                    nDenom, CPrivateSend::GetDenominationsToString(nDenom), session.nSessionDenom, CPrivateSend::GetDenominationsToString(session.nSessionDenom));
         nMessageIDRet = ERR_DENOM;
         return false;
     }
@@ -769,48 +922,54 @@ bool CPrivateSendServer::AddUserToExistingSession(int nDenom, CTransaction txCol
     // count new user as accepted to an existing session
 
     nMessageIDRet = MSG_NOERR;
-    nTimeLastSuccessfulStep = GetTimeMillis();
-    vecSessionCollaterals.push_back(txCollateral);
+    session.nTimeLastSuccessfulStep = GetTimeMillis();
+    session.vecSessionCollaterals.push_back(txCollateral);
+    session.vecSessionAddrs.push_back(addr);
+    if(fLegacy) session.fLegacy = true;
 
     LogPrintf("CPrivateSendServer::AddUserToExistingSession -- new user accepted, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
-            nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom), vecSessionCollaterals.size());
+            session.nSessionID, session.nSessionDenom, CPrivateSend::GetDenominationsToString(session.nSessionDenom), session.vecSessionCollaterals.size());
 
     return true;
 }
 
-void CPrivateSendServer::RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman)
+void CPrivateSendServer::RelayFinalTransaction(CPrivateSendSession& session, const CTransaction& txFinal, CConnman& connman)
 {
     LogPrint("privatesend", "CPrivateSendServer::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
-            __func__, nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
+            __func__, session.nSessionID, session.nSessionDenom, CPrivateSend::GetDenominationsToString(session.nSessionDenom));
 
     // final mixing tx with empty signatures should be relayed to mixing participants only
-    for (const auto entry : vecEntries) {
-        bool fOk = connman.ForNode(entry.addr, [&txFinal, &connman, this](CNode* pnode) {
-            connman.PushMessage(pnode, NetMsgType::DSFINALTX, nSessionID, txFinal);
+    for (const auto entry : session.vecEntries) {
+        bool fOk = connman.ForNode(entry.addr, [&txFinal, &connman, &session](CNode* pnode) {
+            connman.PushMessage(pnode, NetMsgType::DSFINALTX, session.nSessionID, txFinal);
             return true;
         });
         if(!fOk) {
             // no such node? maybe this client disconnected or our own connection went down
-            RelayStatus(STATUS_REJECTED, connman);
+            RelayStatus(session, STATUS_REJECTED, connman);
             break;
         }
     }
 }
 
-void CPrivateSendServer::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
+void CPrivateSendServer::PushStatus(CNode* pnode, const CPrivateSendSession* psession, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
 {
     if(!pnode) return;
-    connman.PushMessage(pnode, NetMsgType::DSSTATUSUPDATE, nSessionID, (int)nState, (int)vecEntries.size(), (int)nStatusUpdate, (int)nMessageID);
+    if(!psession) {
+        connman.PushMessage(pnode, NetMsgType::DSSTATUSUPDATE, 0, (int)POOL_STATE_IDLE, 0, (int)nStatusUpdate, (int)nMessageID);
+        return;
+    }
+    connman.PushMessage(pnode, NetMsgType::DSSTATUSUPDATE, psession->nSessionID, (int)psession->nState, (int)psession->vecEntries.size(), (int)nStatusUpdate, (int)nMessageID);
 }
 
-void CPrivateSendServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID)
+void CPrivateSendServer::RelayStatus(CPrivateSendSession& session, PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID)
 {
     unsigned int nDisconnected{};
     // status updates should be relayed to mixing participants only
-    for (const auto entry : vecEntries) {
+    for (const auto entry : session.vecEntries) {
         // make sure everyone is still connected
-        bool fOk = connman.ForNode(entry.addr, [&nStatusUpdate, &nMessageID, &connman, this](CNode* pnode) {
-            PushStatus(pnode, nStatusUpdate, nMessageID, connman);
+        bool fOk = connman.ForNode(entry.addr, [&nStatusUpdate, &nMessageID, &connman, &session, this](CNode* pnode) {
+            PushStatus(pnode, &session, nStatusUpdate, nMessageID, connman);
             return true;
         });
         if(!fOk) {
@@ -822,51 +981,51 @@ void CPrivateSendServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& c
 
     // smth went wrong
     LogPrintf("CPrivateSendServer::%s -- can't continue, %llu client(s) disconnected, nSessionID: %d  nSessionDenom: %d (%s)\n",
-            __func__, nDisconnected, nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
+            __func__, nDisconnected, session.nSessionID, session.nSessionDenom, CPrivateSend::GetDenominationsToString(session.nSessionDenom));
 
     // notify everyone else that this session should be terminated
-    for (const auto entry : vecEntries) {
-        connman.ForNode(entry.addr, [&connman, this](CNode* pnode) {
-            PushStatus(pnode, STATUS_REJECTED, MSG_NOERR, connman);
+    for (const auto entry : session.vecEntries) {
+        connman.ForNode(entry.addr, [&connman, &session, this](CNode* pnode) {
+            PushStatus(pnode, &session, STATUS_REJECTED, MSG_NOERR, connman);
             return true;
         });
     }
 
-    if(nDisconnected == vecEntries.size()) {
+    if(nDisconnected == session.vecEntries.size()) {
         // all clients disconnected, there is probably some issues with our own connection
-        // do not charge any fees, just reset the pool
-        SetNull();
+        // do not charge any fees, just reset the session
+        EndSession(session, false);
     }
 }
 
-void CPrivateSendServer::RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman)
+void CPrivateSendServer::RelayCompletedTransaction(CPrivateSendSession& session, PoolMessage nMessageID, CConnman& connman)
 {
     LogPrint("privatesend", "CPrivateSendServer::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
-            __func__, nSessionID, nSessionDenom, CPrivateSend::GetDenominationsToString(nSessionDenom));
+            __func__, session.nSessionID, session.nSessionDenom, CPrivateSend::GetDenominationsToString(session.nSessionDenom));
 
     // final mixing tx with empty signatures should be relayed to mixing participants only
-    for (const auto entry : vecEntries) {
-        bool fOk = connman.ForNode(entry.addr, [&nMessageID, &connman, this](CNode* pnode) {
-            connman.PushMessage(pnode, NetMsgType::DSCOMPLETE, nSessionID, (int)nMessageID);
+    for (const auto entry : session.vecEntries) {
+        bool fOk = connman.ForNode(entry.addr, [&nMessageID, &connman, &session](CNode* pnode) {
+            connman.PushMessage(pnode, NetMsgType::DSCOMPLETE, session.nSessionID, (int)nMessageID);
             return true;
         });
         if(!fOk) {
             // no such node? maybe client disconnected or our own connection went down
-            RelayStatus(STATUS_REJECTED, connman);
+            RelayStatus(session, STATUS_REJECTED, connman);
             break;
         }
     }
 }
 
-void CPrivateSendServer::SetState(PoolState nStateNew)
+void CPrivateSendServer::SetState(CPrivateSendSession& session, PoolState nStateNew)
 {
     if(fMasterNode && (nStateNew == POOL_STATE_ERROR || nStateNew == POOL_STATE_SUCCESS)) {
         LogPrint("privatesend", "CPrivateSendServer::SetState -- Can't set state to ERROR or SUCCESS as a Masternode. \n");
         return;
     }
 
-    LogPrintf("CPrivateSendServer::SetState -- nState: %d, nStateNew: %d\n", nState, nStateNew);
-    nState = nStateNew;
+    LogPrintf("CPrivateSendServer::SetState -- nSessionID: %d, nState: %d, nStateNew: %d\n", session.nSessionID, session.nState, nStateNew);
+    session.nState = nStateNew;
 }
 
 //TODO: Rename/move to core
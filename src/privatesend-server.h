@@ -8,71 +8,129 @@
 #include "net.h"
 #include "privatesend.h"
 
+#include <deque>
+
 class CPrivateSendServer;
+class UniValue;
+
+static const int DEFAULT_PRIVATESEND_SESSIONS       = 4;
+static const int PRIVATESEND_SESSIONS_MAX           = 16;
 
 // The main object for accessing mixing
 extern CPrivateSendServer privateSendServer;
 
-/** Used to keep track of current status of mixing pool
+/** A mixing session run by this masternode, one per denomination
  */
-class CPrivateSendServer : public CPrivateSendBase
+class CPrivateSendSession
 {
-private:
+public:
+    int nSessionID;
+    int nSessionDenom;
+    PoolState nState;
+    int64_t nTimeLastSuccessfulStep; // the time when last successful mixing step was performed, in UTC milliseconds
+    // Participants that don't know about concurrent sessions, they would
+    // react to the ready queue of any session on this masternode
+    bool fLegacy;
+
     // Mixing uses collateral transactions to trust parties entering the pool
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransaction> vecSessionCollaterals;
+    // Who was accepted into the session, later messages are matched by address
+    std::vector<CService> vecSessionAddrs;
+
+    std::vector<CDarkSendEntry> vecEntries;
+    CMutableTransaction finalMutableTransaction; // the finalized transaction ready for signing
+
+    CPrivateSendSession(int nSessionID, int nSessionDenom) :
+        nSessionID(nSessionID),
+        nSessionDenom(nSessionDenom),
+        nState(POOL_STATE_IDLE),
+        nTimeLastSuccessfulStep(GetTimeMillis()),
+        fLegacy(false)
+        {}
+
+    int GetEntriesCount() const { return vecEntries.size(); }
+    /// Do we have enough users to take entries?
+    bool IsReady() const { return (int)vecSessionCollaterals.size() >= CPrivateSend::GetMaxPoolTransactions(); }
+    bool HasParticipant(const CService& addr) const;
+};
+
+/** Used to keep track of current status of mixing pool
+ */
+class CPrivateSendServer : public CPrivateSendBase
+{
+protected:
+    // Sessions in progress, by session id. Finished sessions are reset to
+    // POOL_STATE_IDLE and removed by RemoveIdleSessions().
+    std::map<int, CPrivateSendSession> mapSessions;
+
+    // Times sessions finished within the last hour, in seconds
+    std::deque<int64_t> dequeSessionsCompleted;
+    std::deque<int64_t> dequeSessionsFailed;
 
     bool fUnitTest;
 
+    CPrivateSendSession* GetSessionByAddr(const CService& addr);
+    CPrivateSendSession* GetSessionByDenom(int nDenom);
+    bool HasLegacySession() const;
+    void RemoveIdleSessions();
+    /// Reset a session for removal and count how it ended
+    void EndSession(CPrivateSendSession& session, bool fSuccess);
+
     /// Add a clients entry to the pool
-    bool AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
+    bool AddEntry(CPrivateSendSession& session, const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
     /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
+    bool AddScriptSig(CPrivateSendSession& session, const CTxIn& txin);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
-    void ChargeFees(CConnman& connman);
+    void ChargeFees(const CPrivateSendSession& session, CConnman& connman);
     /// Rarely charge fees to pay miners
-    void ChargeRandomFees(CConnman& connman);
+    void ChargeRandomFees(const CPrivateSendSession& session, CConnman& connman);
 
     /// Check for process
-    void CheckPool(CConnman& connman);
+    void CheckPool(CPrivateSendSession& session, CConnman& connman);
 
-    void CreateFinalTransaction(CConnman& connman);
-    void CommitFinalTransaction(CConnman& connman);
+    void CreateFinalTransaction(CPrivateSendSession& session, CConnman& connman);
+    void CommitFinalTransaction(CPrivateSendSession& session, CConnman& connman);
 
     /// Is this nDenom and txCollateral acceptable?
     bool IsAcceptableDenomAndCollateral(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
-    bool CreateNewSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet, CConnman& connman);
-    bool AddUserToExistingSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
-    /// Do we have enough users to take entries?
-    bool IsSessionReady() { return (int)vecSessionCollaterals.size() >= CPrivateSend::GetMaxPoolTransactions(); }
+    bool CreateNewSession(int nDenom, CTransaction txCollateral, const CService& addr, bool fLegacy, PoolMessage &nMessageIDRet, CConnman& connman);
+    bool AddUserToExistingSession(CPrivateSendSession& session, int nDenom, CTransaction txCollateral, const CService& addr, bool fLegacy, PoolMessage &nMessageIDRet);
 
     /// Check that all inputs are signed. (Are all inputs signed?)
-    bool IsSignaturesComplete();
+    bool IsSignaturesComplete(const CPrivateSendSession& session);
     /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    bool IsInputScriptSigValid(const CPrivateSendSession& session, const CTxIn& txin);
     /// Are these outputs compatible with other client in the pool?
-    bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut);
+    bool IsOutputsCompatibleWithSessionDenom(const CPrivateSendSession& session, const std::vector<CTxOut>& vecTxOut);
 
     // Set the 'state' value, with some logging and capturing when the state changed
-    void SetState(PoolState nStateNew);
+    void SetState(CPrivateSendSession& session, PoolState nStateNew);
 
     /// Relay mixing Messages
-    void RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman);
-    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman);
-    void RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID = MSG_NOERR);
-    void RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman);
+    void RelayFinalTransaction(CPrivateSendSession& session, const CTransaction& txFinal, CConnman& connman);
+    void PushStatus(CNode* pnode, const CPrivateSendSession* psession, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman);
+    void RelayStatus(CPrivateSendSession& session, PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID = MSG_NOERR);
+    void RelayCompletedTransaction(CPrivateSendSession& session, PoolMessage nMessageID, CConnman& connman);
 
+    void PruneSessionStats();
     void SetNull();
 
 public:
+    int nMaxSessions; // how many sessions may run at once
+
     CPrivateSendServer() :
-        fUnitTest(false) { SetNull(); }
+        fUnitTest(false),
+        nMaxSessions(DEFAULT_PRIVATESEND_SESSIONS) { SetNull(); }
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     void CheckTimeout(CConnman& connman);
     void CheckForCompleteQueue(CConnman& connman);
+
+    /// Describe the sessions in progress and how many finished in the last hour
+    UniValue GetSessionsInfo();
 };
 
 void ThreadCheckPrivateSendServer(CConnman& connman);
@@ -216,20 +216,20 @@ private:
     int nConfirmedHeight;
 
 public:
-    CTransaction tx;
+    CTransactionRef tx;
     CTxIn vin;
     std::vector<unsigned char> vchSig;
     int64_t sigTime;
 
     CDarksendBroadcastTx() :
         nConfirmedHeight(-1),
-        tx(),
+        tx(MakeTransactionRef()),
         vin(),
         vchSig(),
         sigTime(0)
         {}
 
-    CDarksendBroadcastTx(CTransaction tx, COutPoint outpoint, int64_t sigTime) :
+    CDarksendBroadcastTx(const CTransactionRef& tx, COutPoint outpoint, int64_t sigTime) :
         nConfirmedHeight(-1),
         tx(tx),
         vin(CTxIn(outpoint)),
@@ -249,7 +249,7 @@ public:
 
     friend bool operator==(const CDarksendBroadcastTx& a, const CDarksendBroadcastTx& b)
     {
-        return a.tx == b.tx;
+        return *a.tx == *b.tx;
     }
     friend bool operator!=(const CDarksendBroadcastTx& a, const CDarksendBroadcastTx& b)
     {
@@ -288,6 +288,9 @@ protected:
     void SetNull();
     void CheckQueue();
 
+    // A masternode runs one queue per open session, the dsq rate limit only applies to its first one
+    bool HasQueueFromMasternode(const COutPoint& outpoint) const;
+
 public:
     int nSessionDenom; //Users must submit an denom matching this
 
@@ -295,7 +298,8 @@ public:
 
     int GetQueueSize() const { return vecDarksendQueue.size(); }
     int GetState() const { return nState; }
-    std::string GetStateString() const;
+    std::string GetStateString() const { return GetStateString(nState); }
+    static std::string GetStateString(int nStateIn);
 
     int GetEntriesCount() const { return vecEntries.size(); }
 };
@@ -105,8 +105,9 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
     UniValue txs(UniValue::VARR);
-    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+    BOOST_FOREACH(const CTransactionRef& ptx, block.vtx)
     {
+        const CTransaction& tx = *ptx;
         if(txDetails)
         {
             UniValue objTx(UniValue::VOBJ);
@@ -188,9 +189,19 @@ UniValue mempoolToJSON(bool fVerbose = false)
     if (fVerbose)
     {
         LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
+        // mapTx is hashed by txid, so sort the entries to keep the output stable
+        std::vector<const CTxMemPoolEntry*> vEntries;
+        vEntries.reserve(mempool.mapTx.size());
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+            vEntries.push_back(&e);
+        std::sort(vEntries.begin(), vEntries.end(), [](const CTxMemPoolEntry* a, const CTxMemPoolEntry* b) {
+            return a->GetTx().GetHash() < b->GetTx().GetHash();
+        });
+
+        UniValue o(UniValue::VOBJ);
+        BOOST_FOREACH(const CTxMemPoolEntry* pentry, vEntries)
         {
+            const CTxMemPoolEntry& e = *pentry;
             const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
             info.push_back(Pair("size", (int)e.GetTxSize()));
@@ -226,6 +237,7 @@ UniValue mempoolToJSON(bool fVerbose = false)
     {
         vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
+        std::sort(vtxid.begin(), vtxid.end());
 
         UniValue a(UniValue::VARR);
         BOOST_FOREACH(const uint256& hash, vtxid)
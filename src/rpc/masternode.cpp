@@ -74,14 +74,15 @@ UniValue getpoolinfo(const UniValue& params, bool fHelp)
             "getpoolinfo\n"
             "Returns an object containing mixing pool related information.\n");
 
-#ifdef ENABLE_WALLET
-    CPrivateSendBase* pprivateSendBase = fMasterNode ? (CPrivateSendBase*)&privateSendServer : (CPrivateSendBase*)&privateSendClient;
+    // masternodes run several sessions at once, report each of them
+    if (fMasterNode) return privateSendServer.GetSessionsInfo();
 
+#ifdef ENABLE_WALLET
     UniValue obj(UniValue::VOBJ);
-    obj.push_back(Pair("state",             pprivateSendBase->GetStateString()));
-    obj.push_back(Pair("mixing_mode",       (!fMasterNode && privateSendClient.fPrivateSendMultiSession) ? "multi-session" : "normal"));
-    obj.push_back(Pair("queue",             pprivateSendBase->GetQueueSize()));
-    obj.push_back(Pair("entries",           pprivateSendBase->GetEntriesCount()));
+    obj.push_back(Pair("state",             privateSendClient.GetStateString()));
+    obj.push_back(Pair("mixing_mode",       privateSendClient.fPrivateSendMultiSession ? "multi-session" : "normal"));
+    obj.push_back(Pair("queue",             privateSendClient.GetQueueSize()));
+    obj.push_back(Pair("entries",           privateSendClient.GetEntriesCount()));
     obj.push_back(Pair("status",            privateSendClient.GetStatus()));
 
     masternode_info_t mnInfo;
@@ -96,10 +97,7 @@ UniValue getpoolinfo(const UniValue& params, bool fHelp)
                                                 ? "WARNING: keypool is almost depleted!" : ""));
     }
 #else // ENABLE_WALLET
-    UniValue obj(UniValue::VOBJ);
-    obj.push_back(Pair("state",             privateSendServer.GetStateString()));
-    obj.push_back(Pair("queue",             privateSendServer.GetQueueSize()));
-    obj.push_back(Pair("entries",           privateSendServer.GetEntriesCount()));
+    UniValue obj = privateSendServer.GetSessionsInfo();
 #endif // ENABLE_WALLET
 
     return obj;
@@ -579,6 +579,62 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/**
+ * Paging of the address index RPCs. A "limit" caps the size of the result,
+ * which then becomes an object holding the page and a "next" token; passing
+ * the token back as "after" returns the following page. The token has to
+ * belong to one of the requested addresses. Returns whether a limit was given.
+ */
+template<typename Key>
+static bool getPagingFromParams(const UniValue& params, const std::vector<std::pair<uint160, int> >& addresses, size_t& nLimit, Key& after, bool& fAfter)
+{
+    nLimit = 0;
+    fAfter = false;
+    if (!params[0].isObject())
+        return false;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue afterValue = find_value(params[0].get_obj(), "after");
+    if (limitValue.isNull()) {
+        if (!afterValue.isNull())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "After is only valid together with limit");
+        return false;
+    }
+    if (!limitValue.isNum() || limitValue.get_int() <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be a positive number");
+    nLimit = limitValue.get_int();
+
+    if (!afterValue.isNull()) {
+        if (!afterValue.isStr() || !IsHex(afterValue.get_str()))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid after");
+        CDataStream ss(ParseHex(afterValue.get_str()), SER_DISK, CLIENT_VERSION);
+        try {
+            ss >> after;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid after");
+        }
+        if (std::find(addresses.begin(), addresses.end(), std::make_pair(after.hashBytes, (int)after.type)) == addresses.end())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "After does not belong to any of the addresses");
+        fAfter = true;
+    }
+    return true;
+}
+
+template<typename Key>
+static UniValue getPagingResult(const std::string& name, const UniValue& page, bool fMore, const Key& last)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair(name, page));
+    if (fMore) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << last;
+        result.push_back(Pair("next", HexStr(ss.begin(), ss.end())));
+    } else {
+        result.push_back(Pair("next", NullUniValue));
+    }
+    return result;
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -673,6 +729,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return at most this many outputs, ordered by txid, as an object\n"
+            "  \"after\" (string, optional) The \"next\" value of the previous page\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -685,6 +743,11 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult with limit\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs, as above\n"
+            "  \"next\"  (string) Pass as \"after\" to get the next page, null on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"MbWMQqUNEosjjEb9WAGuJ5KGN9h4WL5bqf\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"MbWMQqUNEosjjEb9WAGuJ5KGN9h4WL5bqf\"]}")
@@ -696,15 +759,27 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit;
+    CAddressUnspentKey after;
+    bool fAfter;
+    bool fPaging = getPagingFromParams(params, addresses, nLimit, after, fAfter);
+    bool fMore = false;
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+    if (fPaging) {
+        if (!GetAddressUnspent(addresses, fAfter ? &after : NULL, nLimit, unspentOutputs, fMore)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-    }
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue result(UniValue::VARR);
 
@@ -724,6 +799,9 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
+    if (fPaging)
+        return getPagingResult("utxos", result, fMore, unspentOutputs.empty() ? after : unspentOutputs.back().first);
+
     return result;
 }
 
@@ -742,6 +820,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many changes, as an object\n"
+            "  \"after\" (string, optional) The \"next\" value of the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -754,6 +834,11 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult with limit:\n"
+            "{\n"
+            "  \"deltas\"  (array) The changes, as above\n"
+            "  \"next\"  (string) Pass as \"after\" to get the next page, null on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"MbWMQqUNEosjjEb9WAGuJ5KGN9h4WL5bqf\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"MbWMQqUNEosjjEb9WAGuJ5KGN9h4WL5bqf\"]}")
@@ -780,18 +865,16 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit;
+    CAddressIndexKey after;
+    bool fAfter;
+    bool fPaging = getPagingFromParams(params, addresses, nLimit, after, fAfter);
+    bool fMore = false;
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (!GetAddressIndex(addresses, start, end, fAfter ? &after : NULL, nLimit, false, addressIndex, fMore)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     UniValue result(UniValue::VARR);
@@ -812,6 +895,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         result.push_back(delta);
     }
 
+    if (fPaging)
+        return getPagingResult("deltas", result, fMore, addressIndex.empty() ? after : addressIndex.back().first);
+
     return result;
 }
 
@@ -845,22 +931,17 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAmount addressBalance = 0;
+        CAmount addressReceived = 0;
+        if (!GetAddressBalance((*it).first, (*it).second, addressBalance, addressReceived)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += addressBalance;
+        received += addressReceived;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -886,12 +967,19 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many txids, as an object\n"
+            "  \"after\" (string, optional) The \"next\" value of the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult with limit:\n"
+            "{\n"
+            "  \"txids\"  (array) The transaction ids, as above\n"
+            "  \"next\"  (string) Pass as \"after\" to get the next page, null on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"MbWMQqUNEosjjEb9WAGuJ5KGN9h4WL5bqf\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"MbWMQqUNEosjjEb9WAGuJ5KGN9h4WL5bqf\"]}")
@@ -914,41 +1002,31 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
+    size_t nLimit;
+    CAddressIndexKey after;
+    bool fAfter;
+    bool fPaging = getPagingFromParams(params, addresses, nLimit, after, fAfter);
+    bool fMore = false;
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    // The entries of all addresses come merged by height and position in the
+    // block, so those of one transaction are adjacent. Pages end on a
+    // transaction boundary, so a txid is never split over two pages.
+    if (!GetAddressIndex(addresses, start, end, fAfter ? &after : NULL, nLimit, true, addressIndex, fMore)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
-    std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
+        if (it == addressIndex.begin() || it->first.txhash != (it - 1)->first.txhash) {
+            result.push_back(it->first.txhash.GetHex());
         }
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
-        }
-    }
+    if (fPaging)
+        return getPagingResult("txids", result, fMore, addressIndex.empty() ? after : addressIndex.back().first);
 
     return result;
 
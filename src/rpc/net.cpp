@@ -90,6 +90,11 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"pingtime\": n,             (numeric) ping time (if available)\n"
             "    \"minping\": n,              (numeric) minimum observed ping time (if any at all)\n"
             "    \"pingwait\": n,             (numeric) ping wait (if non-zero)\n"
+            "    \"processqueue\": n,         (numeric) The number of received messages waiting to be processed\n"
+            "    \"processqueuebytes\": n,    (numeric) The total size in bytes of the received messages waiting to be processed\n"
+            "    \"processtime\": n,          (numeric) The total time in seconds spent processing messages from and to this peer\n"
+            "    \"minfeefilter\": n,         (numeric) The minimum fee rate for transactions this peer accepts\n"
+            "    \"invfeefiltered\": n,       (numeric) The number of transaction inventory items not announced to this peer because of its fee filter\n"
             "    \"version\": v,              (numeric) The peer version, such as 7001\n"
             "    \"subver\": \"/SOV Core:x.x.x/\",  (string) The string version\n"
             "    \"inbound\": true|false,     (boolean) Inbound (true) or Outbound (false)\n"
@@ -147,6 +152,11 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             obj.push_back(Pair("minping", stats.dMinPing));
         if (stats.dPingWait > 0.0)
             obj.push_back(Pair("pingwait", stats.dPingWait));
+        obj.push_back(Pair("processqueue", (uint64_t)stats.nProcessQueueMsgs));
+        obj.push_back(Pair("processqueuebytes", (uint64_t)stats.nProcessQueueBytes));
+        obj.push_back(Pair("processtime", stats.dProcessTime));
+        obj.push_back(Pair("minfeefilter", ValueFromAmount(stats.minFeeFilter)));
+        obj.push_back(Pair("invfeefiltered", stats.nInvFeeFiltered));
         obj.push_back(Pair("version", stats.nVersion));
         // Use the sanitized form of subver here, to avoid tricksy remote peers from
         // corrupting or modifiying the JSON output by putting special characters in
@@ -130,3 +130,81 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+bool CScheduler::AreThreadsServicingQueue() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return nThreadsServicingQueue;
+}
+
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        LOCK(cs_callbacksPending);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once its
+        // not a big deal.
+        if (fCallbacksRunning) return;
+        if (callbacksPending.empty()) return;
+    }
+    pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, this));
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    CScheduler::Function callback;
+    {
+        LOCK(cs_callbacksPending);
+        if (fCallbacksRunning) return;
+        if (callbacksPending.empty()) return;
+        fCallbacksRunning = true;
+
+        callback = callbacksPending.front();
+        callbacksPending.pop_front();
+    }
+
+    // RAII the setting of fCallbacksRunning and calling MaybeScheduleProcessQueue
+    // to ensure both happen safely even if callback() throws.
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        RAIICallbacksRunning(SingleThreadedSchedulerClient* _instance) : instance(_instance) {}
+        ~RAIICallbacksRunning() {
+            {
+                LOCK(instance->cs_callbacksPending);
+                instance->fCallbacksRunning = false;
+            }
+            instance->MaybeScheduleProcessQueue();
+        }
+    } raiicallbacksrunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(CScheduler::Function func)
+{
+    assert(pscheduler);
+
+    {
+        LOCK(cs_callbacksPending);
+        callbacksPending.push_back(func);
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    assert(!pscheduler->AreThreadsServicingQueue());
+    bool fShouldContinue = true;
+    while (fShouldContinue) {
+        ProcessQueue();
+        LOCK(cs_callbacksPending);
+        fShouldContinue = !callbacksPending.empty();
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    LOCK(cs_callbacksPending);
+    return callbacksPending.size();
+}
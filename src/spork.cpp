@@ -15,6 +15,7 @@ class CSporkManager;
 
 CSporkManager sporkManager;
 
+CCriticalSection cs_mapSporks;
 std::map<uint256, CSporkMessage> mapSporks;
 
 void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -53,7 +54,10 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             return;
         }
 
-        mapSporks[hash] = spork;
+        {
+            LOCK(cs_mapSporks);
+            mapSporks[hash] = spork;
+        }
         mapSporksActive[spork.nSporkID] = spork;
         spork.Relay(connman);
 
@@ -108,7 +112,10 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
 
     if(spork.Sign(strMasterPrivKey)) {
         spork.Relay(connman);
-        mapSporks[spork.GetHash()] = spork;
+        {
+            LOCK(cs_mapSporks);
+            mapSporks[spork.GetHash()] = spork;
+        }
         mapSporksActive[nSporkID] = spork;
         return true;
     }
@@ -201,6 +208,18 @@ std::string CSporkManager::GetSporkNameByID(int nSporkID)
     }
 }
 
+bool CSporkManager::GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet)
+{
+    LOCK(cs_mapSporks);
+
+    std::map<uint256, CSporkMessage>::iterator it = mapSporks.find(hash);
+    if (it == mapSporks.end())
+        return false;
+
+    sporkRet = it->second;
+    return true;
+}
+
 bool CSporkManager::SetPrivKey(std::string strPrivKey)
 {
     CSporkMessage spork;
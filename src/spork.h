@@ -39,6 +39,7 @@ static const int64_t SPORK_12_RECONSIDER_BLOCKS_DEFAULT                 = 0;
 static const int64_t SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT               = 4070908800ULL;// OFF
 static const int64_t SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT             = 4070908800ULL;// OFF
 
+extern CCriticalSection cs_mapSporks;
 extern std::map<uint256, CSporkMessage> mapSporks;
 extern CSporkManager sporkManager;
 
@@ -115,6 +116,8 @@ public:
     int GetSporkIDByName(std::string strName);
     std::string GetSporkNameByID(int nSporkID);
 
+    bool GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet);
+
     bool SetPrivKey(std::string strPrivKey);
 };
 
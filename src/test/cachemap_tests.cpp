@@ -124,4 +124,31 @@ BOOST_AUTO_TEST_CASE(cachemap_test)
     BOOST_CHECK(Compare(mapTest1, mapTest4));
 }
 
+BOOST_AUTO_TEST_CASE(cachemap_touch_test)
+{
+    CacheMap<int,int> mapTest(3);
+
+    for(int i = 0; i < 3; ++i) {
+        mapTest.Insert(i, i);
+    }
+
+    // touching the oldest item makes 1 the next one to go
+    mapTest.Touch(0);
+    mapTest.Insert(3, 3);
+    BOOST_CHECK(mapTest.HasKey(0) == true);
+    BOOST_CHECK(mapTest.HasKey(1) == false);
+
+    // touching a missing item is a no-op
+    mapTest.Touch(1);
+    BOOST_CHECK(mapTest.GetSize() == 3);
+
+    mapTest.Insert(4, 4);
+    BOOST_CHECK(mapTest.HasKey(0) == true);
+    BOOST_CHECK(mapTest.HasKey(2) == false);
+
+    int nVal = 0;
+    BOOST_CHECK(mapTest.Get(0, nVal) == true);
+    BOOST_CHECK(nVal == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,11 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/sph_cubehash.h"
+#include "crypto/sph_echo.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_shavite.h"
+#include "crypto/x16r.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_sov.h"
@@ -273,4 +278,36 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+template<typename Context>
+void TestSphHashMatches(const SphHash512& impl, void (*init)(void*), void (*write)(void*, const void*, size_t), void (*close)(void*, void*))
+{
+    std::vector<unsigned char> in(1000);
+    for (int i = 0; i < 64; i++) {
+        size_t len = insecure_rand() % in.size();
+        for (size_t j = 0; j < len; j++)
+            in[j] = insecure_rand();
+        Context ctx;
+        unsigned char expected[64], actual[64];
+        init(&ctx);
+        write(&ctx, &in[0], len);
+        close(&ctx, expected);
+        // Feed the implementation under test in two pieces to exercise its buffering
+        size_t split = len ? insecure_rand() % len : 0;
+        impl.Init(&ctx);
+        impl.Write(&ctx, &in[0], split);
+        impl.Write(&ctx, &in[split], len - split);
+        impl.Close(&ctx, actual);
+        BOOST_CHECK(memcmp(expected, actual, sizeof(expected)) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x16r_autodetect) {
+    // Whichever implementations are picked for this CPU must match the portable sph code
+    BOOST_TEST_MESSAGE("Using the '" + X16RAutoDetect() + "' X16R implementation");
+    TestSphHashMatches<sph_cubehash512_context>(x16rCubehash512, sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close);
+    TestSphHashMatches<sph_groestl512_context>(x16rGroestl512, sph_groestl512_init, sph_groestl512, sph_groestl512_close);
+    TestSphHashMatches<sph_shavite512_context>(x16rShavite512, sph_shavite512_init, sph_shavite512, sph_shavite512_close);
+    TestSphHashMatches<sph_echo512_context>(x16rEcho512, sph_echo512_init, sph_echo512, sph_echo512_close);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
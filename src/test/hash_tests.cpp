@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
+#include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_sov.h"
 
@@ -85,4 +87,57 @@ BOOST_AUTO_TEST_CASE(siphash)
     }*/
 }
 
+BOOST_AUTO_TEST_CASE(block_hash_memo)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = uint256S("000000a1b2c3d4e5f60718293a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d");
+    block.nTime = 1514764800;
+    block.nBits = 0x1e00ffff;
+
+    uint256 hash0 = block.GetHash();
+    BOOST_CHECK(hash0 == HashX16R(BEGIN(block.nVersion), END(block.nNonce), block.hashPrevBlock));
+    block.CacheHash();
+    BOOST_CHECK(block.GetHash() == hash0);
+
+    // Changing a field after the hash was memoized must not return the stale hash
+    block.nNonce++;
+    uint256 hash1 = block.GetHash();
+    BOOST_CHECK(hash1 != hash0);
+    BOOST_CHECK(hash1 == HashX16R(BEGIN(block.nVersion), END(block.nNonce), block.hashPrevBlock));
+
+    // Copies carry the memo along, and stay correct once they diverge
+    block.CacheHash();
+    CBlock copy = block;
+    BOOST_CHECK(copy.GetHash() == hash1);
+    copy.nNonce--;
+    BOOST_CHECK(copy.GetHash() == hash0);
+    BOOST_CHECK(block.GetHash() == hash1);
+
+    block.SetNull();
+    BOOST_CHECK(block.hashCached.IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(x16r_midstate)
+{
+    for (int i = 0; i < 16; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.hashPrevBlock = GetRandHash();
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = 1514764800 + i;
+        header.nBits = 0x1e00ffff;
+
+        CX16RMidstate midstate((const unsigned char*)BEGIN(header.nVersion),
+            BEGIN(header.nNonce) - BEGIN(header.nVersion), header.hashPrevBlock);
+        uint32_t vNonce[3] = {0, insecure_rand(), 0xffffffff};
+        uint256 vHash[3];
+        midstate.Hash(vNonce, 3, vHash);
+        for (int n = 0; n < 3; n++) {
+            header.nNonce = vNonce[n];
+            BOOST_CHECK(vHash[n] == header.GetHash());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
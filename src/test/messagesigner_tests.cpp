@@ -0,0 +1,94 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+
+#include "key.h"
+#include "messagesigner.h"
+#include "random.h"
+#include "uint256.h"
+
+#include "test/test_sov.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(messagesigner_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(hashsignaturecache_lookup)
+{
+    CHashSignatureCache cache;
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+
+    uint256 hash1 = GetRandHash();
+    uint256 hash2 = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(CHashSigner::SignHash(hash1, key1, vchSig));
+
+    uint256 entry;
+    cache.ComputeEntry(entry, hash1, vchSig, key1.GetPubKey());
+    BOOST_CHECK(!cache.Get(entry));
+    cache.Set(entry);
+    BOOST_CHECK(cache.Get(entry));
+
+    // the same signature over another hash, or with another key, is not cached
+    uint256 entryOtherHash, entryOtherKey;
+    cache.ComputeEntry(entryOtherHash, hash2, vchSig, key1.GetPubKey());
+    cache.ComputeEntry(entryOtherKey, hash1, vchSig, key2.GetPubKey());
+    BOOST_CHECK(!cache.Get(entryOtherHash));
+    BOOST_CHECK(!cache.Get(entryOtherKey));
+
+    // entries are salted per cache
+    CHashSignatureCache cacheOther;
+    uint256 entryOtherCache;
+    cacheOther.ComputeEntry(entryOtherCache, hash1, vchSig, key1.GetPubKey());
+    BOOST_CHECK(entryOtherCache != entry);
+}
+
+BOOST_AUTO_TEST_CASE(hashsignaturecache_verify)
+{
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+
+    std::vector<unsigned char> vchSig;
+    std::string strError;
+    BOOST_CHECK(CMessageSigner::SignMessage("message", vchSig, key1));
+
+    // a cached valid signature must not make a changed message or key pass
+    BOOST_CHECK(CMessageSigner::VerifyMessage(key1.GetPubKey(), vchSig, "message", strError));
+    BOOST_CHECK(CMessageSigner::VerifyMessage(key1.GetPubKey(), vchSig, "message", strError));
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(key1.GetPubKey(), vchSig, "message2", strError));
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(key2.GetPubKey(), vchSig, "message", strError));
+
+    // neither does one recovered ahead of time
+    std::vector<unsigned char> vchSig2;
+    uint256 hash = CMessageSigner::GetMessageHash("message3");
+    BOOST_CHECK(CHashSigner::SignHash(hash, key1, vchSig2));
+    CHashSignerCheck check(hash, vchSig2);
+    BOOST_CHECK(check());
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash, key2.GetPubKey(), vchSig2, strError));
+    BOOST_CHECK(CHashSigner::VerifyHash(hash, key1.GetPubKey(), vchSig2, strError));
+}
+
+BOOST_AUTO_TEST_CASE(hashsignaturecache_eviction)
+{
+    static const int nEntries = 10000;
+    CHashSignatureCache cache(64 << 10);
+
+    std::vector<uint256> vEntries;
+    for (int i = 0; i < nEntries; i++) {
+        vEntries.push_back(GetRandHash());
+        cache.Set(vEntries.back());
+    }
+
+    int nCached = 0;
+    for (int i = 0; i < nEntries; i++) {
+        if (cache.Get(vEntries[i]))
+            nCached++;
+    }
+    // bounded by the size limit, and the entry set last is never evicted
+    BOOST_CHECK(nCached > 0);
+    BOOST_CHECK(nCached < nEntries / 2);
+    BOOST_CHECK(cache.Get(vEntries.back()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -190,4 +190,57 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* The cached LWMA/DGW windows must give the same result as a full walk, for
+ * blocks visited in order, at random and on a competing branch. */
+BOOST_AUTO_TEST_CASE(get_next_work_cache)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    // Main chain of 1000 blocks, with a branch of 200 blocks forking off at 600
+    std::vector<CBlockIndex> blocks(1200);
+    std::vector<uint256> hashes(blocks.size());
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        CBlockIndex* pprev = i == 0 ? NULL : i == 1000 ? &blocks[600] : &blocks[i - 1];
+        hashes[i] = GetRandHash();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = pprev;
+        blocks[i].nHeight = pprev ? pprev->nHeight + 1 : 0;
+        // Solvetimes of up to 10 target spacings either way, so that the clamping is exercised
+        blocks[i].nTime = pprev ? pprev->nTime + params.nPowTargetSpacing * 10 - GetRand(params.nPowTargetSpacing * 20) : 1514764800;
+        blocks[i].nBits = 0x1e0fffff - GetRand(0x0f0000);
+        blocks[i].BuildSkip();
+    }
+
+    std::vector<unsigned int> expected(blocks.size());
+    std::vector<unsigned int> expectedLwma(blocks.size());
+    CBlockHeader header;
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        ClearDifficultyCache();
+        expected[i] = GetNextWorkRequired(&blocks[i], &header, params);
+        ClearDifficultyCache();
+        expectedLwma[i] = LwmaCalculateNextWorkRequired(&blocks[i], params);
+    }
+
+    ClearDifficultyCache();
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[i], &header, params), expected[i]);
+        BOOST_CHECK_EQUAL(LwmaCalculateNextWorkRequired(&blocks[i], params), expectedLwma[i]);
+    }
+
+    for (int n = 0; n < 2000; n++) {
+        unsigned int i = GetRand(blocks.size());
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[i], &header, params), expected[i]);
+        BOOST_CHECK_EQUAL(LwmaCalculateNextWorkRequired(&blocks[i], params), expectedLwma[i]);
+    }
+
+    // Alternate between the tips of the two branches while they grow, as
+    // when a reorg is being downloaded.
+    ClearDifficultyCache();
+    for (unsigned int i = 601; i < 800; i++) {
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[i], &header, params), expected[i]);
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[i + 399], &header, params), expected[i + 399]);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,206 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+
+#include "netbase.h"
+#include "privatesend-server.h"
+#include "privatesend.h"
+#include "utiltime.h"
+
+#include "test/test_sov.h"
+
+#include <boost/test/unit_test.hpp>
+
+class CPrivateSendServerTest : public CPrivateSendServer
+{
+public:
+    CPrivateSendServerTest()
+    {
+        fUnitTest = true;
+    }
+
+    CPrivateSendSession* OpenSession(int nDenom, const CService& addr, CConnman& connman)
+    {
+        PoolMessage nMessageID = MSG_NOERR;
+        if(!CreateNewSession(nDenom, CTransaction(), addr, false, nMessageID, connman)) return NULL;
+        return GetSessionByAddr(addr);
+    }
+
+    bool JoinSession(CPrivateSendSession& session, int nDenom, const CService& addr)
+    {
+        PoolMessage nMessageID = MSG_NOERR;
+        return AddUserToExistingSession(session, nDenom, CTransaction(), addr, false, nMessageID);
+    }
+
+    void AddQueue(const CDarksendQueue& dsq) { vecDarksendQueue.push_back(dsq); }
+
+    using CPrivateSendServer::GetSessionByAddr;
+    using CPrivateSendServer::GetSessionByDenom;
+    using CPrivateSendServer::HasQueueFromMasternode;
+    using CPrivateSendServer::CheckPool;
+    using CPrivateSendServer::SetState;
+
+    size_t GetSessionsCount() const { return mapSessions.size(); }
+    int GetSessionsFailed() const { return dequeSessionsFailed.size(); }
+};
+
+static CService SessionAddr(int n)
+{
+    return LookupNumeric(strprintf("250.1.1.%d", n).c_str(), 9999);
+}
+
+static CDarkSendEntry SessionEntry(int n, const CService& addr)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].prevout.n = n;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = n * COIN;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    std::vector<CTxDSIn> vecTxDSIn;
+    vecTxDSIn.push_back(CTxDSIn(tx.vin[0], CScript() << OP_TRUE));
+    CDarkSendEntry entry(vecTxDSIn, tx.vout, CTransaction());
+    entry.addr = addr;
+    return entry;
+}
+
+struct PrivateSendTestingSetup : public TestingSetup
+{
+    bool fMasterNodeSaved;
+
+    PrivateSendTestingSetup()
+    {
+        fMasterNodeSaved = fMasterNode;
+        fMasterNode = true;
+        CPrivateSend::InitStandardDenominations();
+    }
+
+    ~PrivateSendTestingSetup()
+    {
+        fMasterNode = fMasterNodeSaved;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(privatesend_tests, PrivateSendTestingSetup)
+
+BOOST_AUTO_TEST_CASE(privatesend_session_lookup)
+{
+    CPrivateSendServerTest server;
+
+    CPrivateSendSession* psession1 = server.OpenSession(1, SessionAddr(1), *connman);
+    CPrivateSendSession* psession2 = server.OpenSession(2, SessionAddr(2), *connman);
+    BOOST_REQUIRE(psession1 != NULL && psession2 != NULL);
+    BOOST_CHECK(psession1 != psession2);
+    BOOST_CHECK(psession1->nSessionID != psession2->nSessionID);
+    BOOST_CHECK_EQUAL(psession1->nState, POOL_STATE_QUEUE);
+    BOOST_CHECK_EQUAL(server.GetSessionsCount(), 2);
+
+    // only one session per denom
+    BOOST_CHECK(server.OpenSession(1, SessionAddr(3), *connman) == NULL);
+    BOOST_CHECK_EQUAL(server.GetSessionsCount(), 2);
+
+    // participants are found by address, whatever session they joined
+    BOOST_CHECK(server.JoinSession(*psession1, 1, SessionAddr(3)));
+    BOOST_CHECK(!server.JoinSession(*psession2, 1, SessionAddr(4)));
+    BOOST_CHECK(server.GetSessionByAddr(SessionAddr(1)) == psession1);
+    BOOST_CHECK(server.GetSessionByAddr(SessionAddr(3)) == psession1);
+    BOOST_CHECK(server.GetSessionByAddr(SessionAddr(2)) == psession2);
+    BOOST_CHECK(server.GetSessionByAddr(SessionAddr(4)) == NULL);
+    BOOST_CHECK(server.GetSessionByDenom(1) == psession1);
+    BOOST_CHECK(server.GetSessionByDenom(2) == psession2);
+    BOOST_CHECK(server.GetSessionByDenom(4) == NULL);
+
+    // the dsq rate limit is per masternode, its further queues are let through
+    COutPoint outpoint(GetRandHash(), 0);
+    BOOST_CHECK(!server.HasQueueFromMasternode(outpoint));
+    server.AddQueue(CDarksendQueue(1, outpoint, GetAdjustedTime(), false));
+    BOOST_CHECK(server.HasQueueFromMasternode(outpoint));
+    BOOST_CHECK(!server.HasQueueFromMasternode(COutPoint(outpoint.hash, 1)));
+}
+
+BOOST_AUTO_TEST_CASE(privatesend_session_timeout)
+{
+    CPrivateSendServerTest server;
+
+    CPrivateSendSession* psession1 = server.OpenSession(1, SessionAddr(1), *connman);
+    CPrivateSendSession* psession2 = server.OpenSession(2, SessionAddr(2), *connman);
+    BOOST_REQUIRE(psession1 != NULL && psession2 != NULL);
+
+    // nothing is due yet
+    server.CheckTimeout(*connman);
+    BOOST_CHECK_EQUAL(server.GetSessionsCount(), 2);
+    BOOST_CHECK_EQUAL(server.GetSessionsFailed(), 0);
+
+    // a stale session times out on its own, the other one keeps running
+    psession1->nTimeLastSuccessfulStep = GetTimeMillis() - PRIVATESEND_QUEUE_TIMEOUT * 1000 - 1;
+    server.CheckTimeout(*connman);
+    BOOST_CHECK_EQUAL(server.GetSessionsCount(), 1);
+    BOOST_CHECK_EQUAL(server.GetSessionsFailed(), 1);
+    BOOST_CHECK(server.GetSessionByDenom(1) == NULL);
+    BOOST_CHECK(server.GetSessionByAddr(SessionAddr(1)) == NULL);
+    psession2 = server.GetSessionByDenom(2);
+    BOOST_REQUIRE(psession2 != NULL);
+    BOOST_CHECK_EQUAL(psession2->nState, POOL_STATE_QUEUE);
+
+    // signing gets a shorter timeout than the queue
+    server.SetState(*psession2, POOL_STATE_SIGNING);
+    psession2->nTimeLastSuccessfulStep = GetTimeMillis() - PRIVATESEND_SIGNING_TIMEOUT * 1000 - 1;
+    server.CheckTimeout(*connman);
+    BOOST_CHECK_EQUAL(server.GetSessionsCount(), 0);
+    BOOST_CHECK_EQUAL(server.GetSessionsFailed(), 2);
+
+    // the denom is free again
+    BOOST_CHECK(server.OpenSession(1, SessionAddr(1), *connman) != NULL);
+}
+
+BOOST_AUTO_TEST_CASE(privatesend_session_finalization)
+{
+    CPrivateSendServerTest server;
+
+    CPrivateSendSession* psession1 = server.OpenSession(1, SessionAddr(1), *connman);
+    CPrivateSendSession* psession2 = server.OpenSession(2, SessionAddr(2), *connman);
+    BOOST_REQUIRE(psession1 != NULL && psession2 != NULL);
+
+    int nMaxPoolTransactions = CPrivateSend::GetMaxPoolTransactions();
+    std::vector<CDarkSendEntry> vecEntries;
+    for(int i = 0; i < nMaxPoolTransactions; i++) {
+        CService addr = SessionAddr(10 + i);
+        if(i > 0) BOOST_CHECK(server.JoinSession(*psession1, 1, addr));
+        vecEntries.push_back(SessionEntry(i + 1, i > 0 ? addr : SessionAddr(1)));
+    }
+    BOOST_CHECK(psession1->IsReady());
+    server.SetState(*psession1, POOL_STATE_ACCEPTING_ENTRIES);
+    psession2->vecEntries.push_back(SessionEntry(100, SessionAddr(2)));
+
+    // not all entries are in yet
+    psession1->vecEntries.assign(vecEntries.begin(), vecEntries.end() - 1);
+    server.CheckPool(*psession1, *connman);
+    BOOST_CHECK_EQUAL(psession1->nState, POOL_STATE_ACCEPTING_ENTRIES);
+    BOOST_CHECK(psession1->finalMutableTransaction.vin.empty());
+
+    // the final transaction is made of this session's entries only
+    psession1->vecEntries = vecEntries;
+    server.CheckPool(*psession1, *connman);
+    const CMutableTransaction& txFinal = psession1->finalMutableTransaction;
+    BOOST_CHECK_EQUAL(txFinal.vin.size(), nMaxPoolTransactions);
+    BOOST_CHECK_EQUAL(txFinal.vout.size(), nMaxPoolTransactions);
+    for(int i = 0; i < nMaxPoolTransactions; i++) {
+        BOOST_CHECK(std::count(txFinal.vin.begin(), txFinal.vin.end(), (CTxIn)vecEntries[i].vecTxDSIn[0]) == 1);
+        BOOST_CHECK(std::count(txFinal.vout.begin(), txFinal.vout.end(), vecEntries[i].vecTxOut[0]) == 1);
+        if(i > 0) BOOST_CHECK(!CompareInputBIP69()(txFinal.vin[i], txFinal.vin[i - 1]));
+    }
+
+    // no participant is connected to receive it, so the session ends as failed
+    // while the other one is left alone
+    BOOST_CHECK_EQUAL(psession1->nState, POOL_STATE_IDLE);
+    BOOST_CHECK_EQUAL(server.GetSessionsFailed(), 1);
+    BOOST_CHECK_EQUAL(psession2->nState, POOL_STATE_QUEUE);
+    BOOST_CHECK_EQUAL(psession2->GetEntriesCount(), 1);
+    BOOST_CHECK(psession2->finalMutableTransaction.vin.empty());
+
+    server.CheckTimeout(*connman);
+    BOOST_CHECK_EQUAL(server.GetSessionsCount(), 1);
+    BOOST_CHECK(server.GetSessionByDenom(2) == psession2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
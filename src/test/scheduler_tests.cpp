@@ -116,4 +116,42 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+static void orderedTask(int i, int& counter, bool& fOrdered)
+{
+    // Not synchronized: the client must never run two of these at once
+    if (counter++ != i)
+        fOrdered = false;
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // Each client runs its callbacks in order, whatever the other does
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    // More threads than clients: the extra threads must find nothing to do,
+    // or callbacks of one client would run concurrently and out of order
+    boost::thread_group threads;
+    for (int i = 0; i < 5; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    int counter1 = 0, counter2 = 0;
+    bool fOrdered1 = true, fOrdered2 = true;
+    for (int i = 0; i < 100; i++) {
+        queue1.AddToProcessQueue(boost::bind(&orderedTask, i, boost::ref(counter1), boost::ref(fOrdered1)));
+        queue2.AddToProcessQueue(boost::bind(&orderedTask, i, boost::ref(counter2), boost::ref(fOrdered2)));
+    }
+
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK(fOrdered1);
+    BOOST_CHECK(fOrdered2);
+    BOOST_CHECK_EQUAL(counter1, 100);
+    BOOST_CHECK_EQUAL(counter2, 100);
+    BOOST_CHECK_EQUAL(queue1.CallbacksPending(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -24,6 +24,7 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
@@ -237,77 +238,352 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CAddressUnspentCursor cursor(*this, addressHash, type);
+    for (; cursor.Valid(); cursor.Next()) {
+        boost::this_thread::interruption_point();
+        unspentOutputs.push_back(make_pair(cursor.GetKey(), cursor.GetValue()));
+    }
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    return !cursor.Failed();
+}
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
-        }
+CAddressUnspentCursor::CAddressUnspentCursor(CBlockTreeDB &db, uint160 addressHash, int type, const CAddressUnspentKey *pafter) :
+    pcursor(db.NewIterator()), hashBytes(addressHash), fValid(false), fError(false)
+{
+    if (pafter && pafter->type == (unsigned int)type && pafter->hashBytes == addressHash) {
+        pcursor->SeekAfter(make_pair(DB_ADDRESSUNSPENTINDEX, *pafter));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+    ReadEntry();
+}
+
+void CAddressUnspentCursor::ReadEntry()
+{
+    fValid = false;
+    if (!pcursor->Valid())
+        return;
+    std::pair<char,CAddressUnspentKey> keyTmp;
+    if (!pcursor->GetKey(keyTmp) || keyTmp.first != DB_ADDRESSUNSPENTINDEX || keyTmp.second.hashBytes != hashBytes)
+        return;
+    if (!pcursor->GetValue(value)) {
+        fError = true;
+        error("failed to get address unspent value");
+        return;
+    }
+    key = keyTmp.second;
+    fValid = true;
+}
+
+void CAddressUnspentCursor::Next()
+{
+    pcursor->Next();
+    ReadEntry();
+}
+
+// The balance of each address is kept next to its address index entries and
+// written in the same batch. A delta only moves the balance when its entry is
+// actually added or removed, so a block connected again after an unclean
+// shutdown isn't counted twice.
+typedef std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue> AddressBalanceDeltaMap;
+
+static void AddAddressBalanceDelta(AddressBalanceDeltaMap &mapDelta, const CAddressIndexKey &key, CAmount nValue, int nSign) {
+    CAddressBalanceValue &delta = mapDelta[std::make_pair(key.type, key.hashBytes)];
+    delta.balance += nSign * nValue;
+    if (nValue > 0)
+        delta.received += nSign * nValue;
+}
+
+// Orders the entries of one address, for looking them up by key
+struct CAddressIndexEntryCompare
+{
+    bool operator()(const CAddressIndexKey &a, const CAddressIndexKey &b) const {
+        if (a.blockHeight != b.blockHeight)
+            return a.blockHeight < b.blockHeight;
+        if (a.txindex != b.txindex)
+            return a.txindex < b.txindex;
+        if (a.txhash != b.txhash)
+            return a.txhash < b.txhash;
+        if (a.index != b.index)
+            return a.index < b.index;
+        return a.spending < b.spending;
     }
+};
+
+// Adds the balance changes of the entries which are not yet (nSign > 0) or
+// still (nSign < 0) in the index. The entries are grouped by address and the
+// existing ones of each address are read with one range scan over the heights
+// the entries span, which for a block covers just the entries of that block.
+static bool AddAddressBalanceDeltas(CBlockTreeDB &db, AddressBalanceDeltaMap &mapDelta, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, int nSign) {
+    typedef std::map<std::pair<unsigned int, uint160>, std::vector<std::pair<CAddressIndexKey, CAmount> > > AddressEntriesMap;
+    AddressEntriesMap mapEntries;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        mapEntries[std::make_pair(it->first.type, it->first.hashBytes)].push_back(*it);
+
+    for (AddressEntriesMap::const_iterator it = mapEntries.begin(); it != mapEntries.end(); it++) {
+        int nMinHeight = std::numeric_limits<int>::max();
+        int nMaxHeight = 0;
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator itEntry = it->second.begin(); itEntry != it->second.end(); itEntry++) {
+            nMinHeight = std::min(nMinHeight, itEntry->first.blockHeight);
+            nMaxHeight = std::max(nMaxHeight, itEntry->first.blockHeight);
+        }
 
+        std::set<CAddressIndexKey, CAddressIndexEntryCompare> setExisting;
+        CAddressIndexCursor cursor(db, it->first.second, it->first.first, nMinHeight, nMaxHeight);
+        for (; cursor.Valid(); cursor.Next()) {
+            if (cursor.GetKey().type == it->first.first)
+                setExisting.insert(cursor.GetKey());
+        }
+        if (cursor.Failed())
+            return false;
+
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator itEntry = it->second.begin(); itEntry != it->second.end(); itEntry++) {
+            bool fExists = setExisting.count(itEntry->first) > 0;
+            if (fExists != (nSign > 0))
+                AddAddressBalanceDelta(mapDelta, itEntry->first, itEntry->second, nSign);
+        }
+    }
     return true;
 }
 
+static void WriteAddressBalanceDeltas(CBlockTreeDB &db, CDBBatch &batch, const AddressBalanceDeltaMap &mapDelta) {
+    for (AddressBalanceDeltaMap::const_iterator it = mapDelta.begin(); it != mapDelta.end(); it++) {
+        CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        CAddressBalanceValue value;
+        db.Read(make_pair(DB_ADDRESSBALANCEINDEX, key), value);
+        value.balance += it->second.balance;
+        value.received += it->second.received;
+        if (value.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSBALANCEINDEX, key));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, key), value);
+        }
+    }
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    AddressBalanceDeltaMap mapDelta;
+    if (!AddAddressBalanceDeltas(*this, mapDelta, vect, 1))
+        return false;
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    WriteAddressBalanceDeltas(*this, batch, mapDelta);
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    AddressBalanceDeltaMap mapDelta;
+    if (!AddAddressBalanceDeltas(*this, mapDelta, vect, -1))
+        return false;
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    WriteAddressBalanceDeltas(*this, batch, mapDelta);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    // Addresses that never received anything have no entry
+    if (!Read(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value))
+        value.SetNull();
+    return true;
+}
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+// Address indexes created before the balance index existed: sum up the
+// entries of every address once. The entries are sorted by address, so one
+// pass over them is enough.
+bool CBlockTreeDB::BuildAddressBalanceIndex() {
+    LogPrintf("Building address balance index...\n");
 
-    if (start > 0 && end > 0) {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(DB_ADDRESSINDEX);
 
-    while (pcursor->Valid()) {
+    CDBBatch batch(*this);
+    std::pair<unsigned int, uint160> address;
+    CAddressBalanceValue value;
+    size_t nAddresses = 0;
+    while (true) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX;
+        if (!fValid || std::make_pair(key.second.type, key.second.hashBytes) != address) {
+            if (!value.IsNull()) {
+                batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(address.first, address.second)), value);
+                if (++nAddresses % 100000 == 0)
+                    LogPrintf("Building address balance index... %u addresses\n", nAddresses);
             }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
+            if (batch.SizeEstimate() > (size_t)1 << 24) {
+                if (!WriteBatch(batch))
+                    return error("%s: failed to write address balance index", __func__);
+                batch.Clear();
             }
-        } else {
-            break;
+            if (!fValid)
+                break;
+            address = std::make_pair(key.second.type, key.second.hashBytes);
+            value.SetNull();
         }
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("%s: failed to get address index value", __func__);
+        value.balance += nValue;
+        if (nValue > 0)
+            value.received += nValue;
+        pcursor->Next();
     }
 
+    batch.Write(std::make_pair(DB_FLAG, std::string("addressbalanceindex")), '1');
+    if (!WriteBatch(batch, true))
+        return error("%s: failed to write address balance index", __func__);
+
+    LogPrintf("Building address balance index done, %u addresses\n", nAddresses);
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end) {
+
+    // The start height only applies together with an end height
+    CAddressIndexCursor cursor(*this, addressHash, type, (start > 0 && end > 0) ? start : 0, end);
+    for (; cursor.Valid(); cursor.Next()) {
+        boost::this_thread::interruption_point();
+        addressIndex.push_back(make_pair(cursor.GetKey(), cursor.GetValue()));
+    }
+
+    return !cursor.Failed();
+}
+
+CAddressIndexCursor::CAddressIndexCursor(CBlockTreeDB &db, uint160 addressHash, int type, int start, int endIn, const CAddressIndexKey *pafter) :
+    pcursor(db.NewIterator()), hashBytes(addressHash), end(endIn), fValid(false), fError(false), nValue(0)
+{
+    Init(type, start, pafter);
+}
+
+CAddressIndexCursor::CAddressIndexCursor(CDBIterator *pcursorIn, uint160 addressHash, int type, int start, int endIn, const CAddressIndexKey *pafter) :
+    pcursor(pcursorIn), hashBytes(addressHash), end(endIn), fValid(false), fError(false), nValue(0)
+{
+    Init(type, start, pafter);
+}
+
+void CAddressIndexCursor::Init(int type, int start, const CAddressIndexKey *pafter)
+{
+    if (pafter && pafter->type == (unsigned int)type && pafter->hashBytes == hashBytes && pafter->blockHeight >= start) {
+        pcursor->SeekAfter(make_pair(DB_ADDRESSINDEX, *pafter));
+    } else if (start > 0) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, hashBytes, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, hashBytes)));
+    }
+    ReadEntry();
+}
+
+void CAddressIndexCursor::ReadEntry()
+{
+    fValid = false;
+    if (!pcursor->Valid())
+        return;
+    std::pair<char,CAddressIndexKey> keyTmp;
+    if (!pcursor->GetKey(keyTmp) || keyTmp.first != DB_ADDRESSINDEX || keyTmp.second.hashBytes != hashBytes)
+        return;
+    if (end > 0 && keyTmp.second.blockHeight > end)
+        return;
+    if (!pcursor->GetValue(nValue)) {
+        fError = true;
+        error("failed to get address index value");
+        return;
+    }
+    key = keyTmp.second;
+    fValid = true;
+}
+
+void CAddressIndexCursor::Next()
+{
+    pcursor->Next();
+    ReadEntry();
+}
+
+void CAddressIndexCursor::Seek(const CAddressIndexKey &keyIn)
+{
+    assert(keyIn.hashBytes == hashBytes);
+    pcursor->Seek(make_pair(DB_ADDRESSINDEX, keyIn));
+    ReadEntry();
+}
+
+bool CAddressIndexMergedCursor::KeyLess(const CAddressIndexKey &a, const CAddressIndexKey &b)
+{
+    if (a.blockHeight != b.blockHeight)
+        return a.blockHeight < b.blockHeight;
+    if (a.txindex != b.txindex)
+        return a.txindex < b.txindex;
+    if (a.type != b.type)
+        return a.type < b.type;
+    if (a.hashBytes != b.hashBytes)
+        return a.hashBytes < b.hashBytes;
+    if (a.txhash != b.txhash)
+        return a.txhash < b.txhash;
+    if (a.index != b.index) {
+        // Stored little endian, compare the way LevelDB orders the keys
+        for (int i = 0; i < 32; i += 8) {
+            unsigned char ca = (a.index >> i) & 0xff, cb = (b.index >> i) & 0xff;
+            if (ca != cb)
+                return ca < cb;
+        }
+    }
+    return a.spending < b.spending;
+}
+
+CAddressIndexMergedCursor::CAddressIndexMergedCursor(CBlockTreeDB &db, const std::vector<std::pair<uint160, int> > &addresses,
+                                                     int start, int end, const CAddressIndexKey *pafter) :
+    snapshot(db), fError(false)
+{
+    vCursors.reserve(addresses.size());
+    vHeap.reserve(addresses.size());
+    for (size_t i = 0; i < addresses.size(); i++) {
+        const uint160 &hashBytes = addresses[i].first;
+        unsigned int type = addresses[i].second;
+        vCursors.push_back(new CAddressIndexCursor(snapshot.NewIterator(), hashBytes, type, start, end, pafter));
+        CAddressIndexCursor &cursor = *vCursors.back();
+
+        // The cursor of the address pafter belongs to already resumed after
+        // it. The others skip the entries that come before pafter in the
+        // merged order: those of earlier blocks and transactions, and of the
+        // same transaction if their address sorts first.
+        if (pafter && (pafter->type != type || pafter->hashBytes != hashBytes) && pafter->blockHeight >= start) {
+            bool fBefore = type < pafter->type || (type == pafter->type && hashBytes < pafter->hashBytes);
+            CAddressIndexKey key(type, hashBytes, pafter->blockHeight, pafter->txindex + (fBefore ? 1 : 0), uint256(), 0, false);
+            if (cursor.Valid() && KeyLess(cursor.GetKey(), key))
+                cursor.Seek(key);
+        }
+
+        if (cursor.Failed())
+            fError = true;
+        if (cursor.Valid())
+            vHeap.push_back(i);
+    }
+    std::make_heap(vHeap.begin(), vHeap.end(), HeapGreater(vCursors));
+}
+
+CAddressIndexMergedCursor::~CAddressIndexMergedCursor()
+{
+    for (size_t i = 0; i < vCursors.size(); i++)
+        delete vCursors[i];
+}
+
+void CAddressIndexMergedCursor::Next()
+{
+    std::pop_heap(vHeap.begin(), vHeap.end(), HeapGreater(vCursors));
+    CAddressIndexCursor &cursor = *vCursors[vHeap.back()];
+    cursor.Next();
+    if (cursor.Valid()) {
+        std::push_heap(vHeap.begin(), vHeap.end(), HeapGreater(vCursors));
+    } else {
+        if (cursor.Failed())
+            fError = true;
+        vHeap.pop_back();
+    }
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -107,6 +107,109 @@ private:
     friend class CCoinsViewDB;
 };
 
+class CBlockTreeDB;
+
+/**
+ * Iterates over the address index entries of one address in key order, that
+ * is by height and then position in the block, without loading them all.
+ * An iteration can be resumed after the last key it returned.
+ */
+class CAddressIndexCursor
+{
+private:
+    boost::scoped_ptr<CDBIterator> pcursor;
+    uint160 hashBytes;
+    int end;
+    bool fValid;
+    bool fError;
+    CAddressIndexKey key;
+    CAmount nValue;
+
+    void Init(int type, int start, const CAddressIndexKey *pafter);
+    void ReadEntry();
+
+public:
+    /** start and end are inclusive heights, 0 for no bound. If pafter is set, start after that key. */
+    CAddressIndexCursor(CBlockTreeDB &db, uint160 addressHash, int type, int start = 0, int end = 0, const CAddressIndexKey *pafter = NULL);
+    /** Same, reading through pcursorIn, which the cursor takes ownership of */
+    CAddressIndexCursor(CDBIterator *pcursorIn, uint160 addressHash, int type, int start = 0, int end = 0, const CAddressIndexKey *pafter = NULL);
+
+    bool Valid() const { return fValid; }
+    //! Whether the iteration stopped because an entry could not be read
+    bool Failed() const { return fError; }
+    const CAddressIndexKey &GetKey() const { return key; }
+    CAmount GetValue() const { return nValue; }
+    void Next();
+    //! Move to the first entry at or after key, which must belong to this address
+    void Seek(const CAddressIndexKey &keyIn);
+};
+
+/**
+ * Merges the address index entries of several addresses, read from one
+ * snapshot, into a single stream ordered by height and position in the
+ * block. Only the current entry of every address is held in memory.
+ * Entries of one transaction are adjacent, ordered by address and then as
+ * in the database.
+ */
+class CAddressIndexMergedCursor
+{
+private:
+    CDBSnapshot snapshot;
+    std::vector<CAddressIndexCursor*> vCursors;
+    //! Min-heap of the indexes of the valid cursors in vCursors
+    std::vector<size_t> vHeap;
+    bool fError;
+
+    struct HeapGreater
+    {
+        const std::vector<CAddressIndexCursor*> &vCursors;
+        explicit HeapGreater(const std::vector<CAddressIndexCursor*> &vCursorsIn) : vCursors(vCursorsIn) {}
+        bool operator()(size_t a, size_t b) const { return KeyLess(vCursors[b]->GetKey(), vCursors[a]->GetKey()); }
+    };
+
+    CAddressIndexMergedCursor(const CAddressIndexMergedCursor&);
+    void operator=(const CAddressIndexMergedCursor&);
+
+public:
+    /** start and end are inclusive heights, 0 for no bound. If pafter is set, start after that key. */
+    CAddressIndexMergedCursor(CBlockTreeDB &db, const std::vector<std::pair<uint160, int> > &addresses,
+                              int start = 0, int end = 0, const CAddressIndexKey *pafter = NULL);
+    ~CAddressIndexMergedCursor();
+
+    bool Valid() const { return !vHeap.empty(); }
+    bool Failed() const { return fError; }
+    const CAddressIndexKey &GetKey() const { return vCursors[vHeap.front()]->GetKey(); }
+    CAmount GetValue() const { return vCursors[vHeap.front()]->GetValue(); }
+    void Next();
+
+    /** Whether a comes before b in the merged order */
+    static bool KeyLess(const CAddressIndexKey &a, const CAddressIndexKey &b);
+};
+
+/** Iterates over the unspent outputs of one address in key order (txid, output index). */
+class CAddressUnspentCursor
+{
+private:
+    boost::scoped_ptr<CDBIterator> pcursor;
+    uint160 hashBytes;
+    bool fValid;
+    bool fError;
+    CAddressUnspentKey key;
+    CAddressUnspentValue value;
+
+    void ReadEntry();
+
+public:
+    /** If pafter is set, start after that key. */
+    CAddressUnspentCursor(CBlockTreeDB &db, uint160 addressHash, int type, const CAddressUnspentKey *pafter = NULL);
+
+    bool Valid() const { return fValid; }
+    bool Failed() const { return fError; }
+    const CAddressUnspentKey &GetKey() const { return key; }
+    const CAddressUnspentValue &GetValue() const { return value; }
+    void Next();
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -133,6 +236,8 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+    bool BuildAddressBalanceIndex();
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
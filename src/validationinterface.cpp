@@ -5,54 +5,299 @@
 
 #include "validationinterface.h"
 
+#include "chain.h"
+#include "primitives/block.h"
+#include "scheduler.h"
+
+#include <boost/signals2/signal.hpp>
+
+/** The chain and mempool events, which may be delivered from the background queue */
+struct ChainSignals {
+    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+    boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+    boost::signals2::signal<void (const CBlock &, const CBlockIndex *)> BlockConnected;
+    boost::signals2::signal<void (const CBlock &, const CBlockIndex *)> BlockDisconnected;
+    boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
+    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+
+    void Connect(CValidationInterface* pwalletIn);
+    void Disconnect(CValidationInterface* pwalletIn);
+    void DisconnectAll();
+
+    void FireBlockConnected(const CBlock &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &vtxConflicted) {
+        BlockConnected(block, pindex);
+        // Tell wallet about transactions that went from mempool
+        // to conflicted:
+        for (const CTransactionRef& ptx : vtxConflicted) {
+            SyncTransaction(*ptx, NULL);
+        }
+        // ... and about transactions that got confirmed:
+        for (const CTransactionRef& ptx : block.vtx) {
+            SyncTransaction(*ptx, &block);
+        }
+    }
+
+    void FireBlockDisconnected(const CBlock &block, const CBlockIndex *pindex) {
+        BlockDisconnected(block, pindex);
+        // Let wallets know transactions went from 1-confirmed to
+        // 0-confirmed or conflicted:
+        for (const CTransactionRef& ptx : block.vtx) {
+            SyncTransaction(*ptx, NULL);
+        }
+    }
+};
+
+struct MainSignalsInstance {
+    boost::signals2::signal<void (const CBlockIndex *)> AcceptedBlockHeader;
+    boost::signals2::signal<void (const CBlockIndex *, bool fInitialDownload)> NotifyHeaderTip;
+    boost::signals2::signal<void (const uint256 &)> Inventory;
+    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
+    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    boost::signals2::signal<void (const uint256 &)> BlockFound;
+
+    // Chain events for the listeners that keep up with the tip (peer logic,
+    // masternodes, payments, InstantSend...), fired from the thread that
+    // raised them, often while holding cs_main
+    ChainSignals chain;
+    // Chain events for the background listeners (wallet, ZMQ)
+    ChainSignals background;
+
+    // The scheduler may run tasks on several threads, but listeners must see
+    // events in the order they were raised, so queued events go through our
+    // own serial queue on top of it. NULL until a scheduler is registered.
+    CScheduler* pscheduler;
+    std::unique_ptr<SingleThreadedSchedulerClient> pschedulerClient;
+
+    MainSignalsInstance() : pscheduler(NULL) {}
+
+    void Enqueue(CScheduler::Function func) {
+        if (pschedulerClient)
+            pschedulerClient->AddToProcessQueue(func);
+        else
+            func();
+    }
+};
+
+void ChainSignals::Connect(CValidationInterface* pwalletIn) {
+    UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
+    BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
+    BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
+    NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
+    SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+}
+
+void ChainSignals::Disconnect(CValidationInterface* pwalletIn) {
+    SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+    UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
+    NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
+    BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
+    SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
+    UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+}
+
+void ChainSignals::DisconnectAll() {
+    SetBestChain.disconnect_all_slots();
+    UpdatedTransaction.disconnect_all_slots();
+    NotifyTransactionLock.disconnect_all_slots();
+    BlockDisconnected.disconnect_all_slots();
+    BlockConnected.disconnect_all_slots();
+    SyncTransaction.disconnect_all_slots();
+    UpdatedBlockTip.disconnect_all_slots();
+}
+
 static CMainSignals g_signals;
 
+CMainSignals::CMainSignals() : m_internals(new MainSignalsInstance()) {}
+
+CMainSignals::~CMainSignals() {}
+
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    assert(!m_internals->pschedulerClient);
+    m_internals->pscheduler = &scheduler;
+    m_internals->pschedulerClient.reset(new SingleThreadedSchedulerClient(&scheduler));
+}
+
+void CMainSignals::UnregisterBackgroundSignalScheduler() {
+    m_internals->pschedulerClient.reset();
+    m_internals->pscheduler = NULL;
+}
+
+void CMainSignals::FlushBackgroundCallbacks() {
+    if (!m_internals->pschedulerClient)
+        return;
+    // After a failed startup the scheduler thread may not have been joined
+    if (m_internals->pscheduler->AreThreadsServicingQueue())
+        SyncWithValidationInterfaceQueue();
+    else
+        m_internals->pschedulerClient->EmptyQueue();
+}
+
+size_t CMainSignals::CallbacksPending() {
+    if (!m_internals->pschedulerClient)
+        return 0;
+    return m_internals->pschedulerClient->CallbacksPending();
+}
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
-    g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
-    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fBackground) {
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
+    signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
+    (fBackground ? signals.background : signals.chain).Connect(pwalletIn);
+    signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+    signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
+    signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+    signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-    g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.NotifyHeaderTip.disconnect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.AcceptedBlockHeader.disconnect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+    signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
+    signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+    signals.background.Disconnect(pwalletIn);
+    signals.chain.Disconnect(pwalletIn);
+    signals.NotifyHeaderTip.disconnect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
+    signals.AcceptedBlockHeader.disconnect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
 }
 
 void UnregisterAllValidationInterfaces() {
-    g_signals.BlockFound.disconnect_all_slots();
-    g_signals.ScriptForMining.disconnect_all_slots();
-    g_signals.BlockChecked.disconnect_all_slots();
-    g_signals.Broadcast.disconnect_all_slots();
-    g_signals.Inventory.disconnect_all_slots();
-    g_signals.SetBestChain.disconnect_all_slots();
-    g_signals.UpdatedTransaction.disconnect_all_slots();
-    g_signals.NotifyTransactionLock.disconnect_all_slots();
-    g_signals.SyncTransaction.disconnect_all_slots();
-    g_signals.UpdatedBlockTip.disconnect_all_slots();
-    g_signals.NotifyHeaderTip.disconnect_all_slots();
-    g_signals.AcceptedBlockHeader.disconnect_all_slots();
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    signals.BlockFound.disconnect_all_slots();
+    signals.ScriptForMining.disconnect_all_slots();
+    signals.BlockChecked.disconnect_all_slots();
+    signals.Broadcast.disconnect_all_slots();
+    signals.Inventory.disconnect_all_slots();
+    signals.background.DisconnectAll();
+    signals.chain.DisconnectAll();
+    signals.NotifyHeaderTip.disconnect_all_slots();
+    signals.AcceptedBlockHeader.disconnect_all_slots();
+}
+
+namespace {
+struct QueueSyncPoint {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fReached;
+    QueueSyncPoint() : fReached(false) {}
+};
+}
+
+void SyncWithValidationInterfaceQueue()
+{
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    if (!signals.pschedulerClient)
+        return;
+
+    // Shared with the queued callback, which outlives this call if the
+    // scheduler stops before reaching it.
+    std::shared_ptr<QueueSyncPoint> sync = std::make_shared<QueueSyncPoint>();
+    signals.Enqueue([sync] {
+        {
+            boost::unique_lock<boost::mutex> lock(sync->mutex);
+            sync->fReached = true;
+        }
+        sync->cond.notify_all();
+    });
+
+    boost::unique_lock<boost::mutex> lock(sync->mutex);
+    while (!sync->fReached && signals.pscheduler->AreThreadsServicingQueue()) {
+        sync->cond.wait_for(lock, boost::chrono::milliseconds(100));
+    }
+}
+
+void CMainSignals::AcceptedBlockHeader(const CBlockIndex *pindexNew) {
+    m_internals->AcceptedBlockHeader(pindexNew);
+}
+
+void CMainSignals::NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) {
+    m_internals->NotifyHeaderTip(pindexNew, fInitialDownload);
+}
+
+void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    signals->Enqueue([signals, pindexNew, pindexFork, fInitialDownload] {
+        signals->background.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    });
+}
+
+void CMainSignals::SyncTransaction(const CTransactionRef &ptx) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.SyncTransaction(*ptx, NULL);
+    signals->Enqueue([signals, ptx] {
+        signals->background.SyncTransaction(*ptx, NULL);
+    });
+}
+
+void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef> &vtxConflicted) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.FireBlockConnected(*pblock, pindex, vtxConflicted);
+    signals->Enqueue([signals, pblock, pindex, vtxConflicted] {
+        signals->background.FireBlockConnected(*pblock, pindex, vtxConflicted);
+    });
+}
+
+void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.FireBlockDisconnected(*pblock, pindex);
+    signals->Enqueue([signals, pblock, pindex] {
+        signals->background.FireBlockDisconnected(*pblock, pindex);
+    });
+}
+
+void CMainSignals::NotifyTransactionLock(const CTransactionRef &ptx) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.NotifyTransactionLock(*ptx);
+    signals->Enqueue([signals, ptx] {
+        signals->background.NotifyTransactionLock(*ptx);
+    });
+}
+
+void CMainSignals::UpdatedTransaction(const uint256 &hash) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.UpdatedTransaction(hash);
+    signals->Enqueue([signals, hash] {
+        signals->background.UpdatedTransaction(hash);
+    });
+}
+
+void CMainSignals::SetBestChain(const CBlockLocator &locator) {
+    MainSignalsInstance* signals = m_internals.get();
+    signals->chain.SetBestChain(locator);
+    signals->Enqueue([signals, locator] {
+        signals->background.SetBestChain(locator);
+    });
+}
+
+void CMainSignals::Inventory(const uint256 &hash) {
+    m_internals->Inventory(hash);
+}
+
+void CMainSignals::Broadcast(int64_t nBestBlockTime, CConnman* connman) {
+    m_internals->Broadcast(nBestBlockTime, connman);
+}
+
+void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& state) {
+    m_internals->BlockChecked(block, state);
+}
+
+void CMainSignals::ScriptForMining(boost::shared_ptr<CReserveScript>& coinbaseScript) {
+    m_internals->ScriptForMining(coinbaseScript);
+}
+
+void CMainSignals::BlockFound(const uint256 &hash) {
+    m_internals->BlockFound(hash);
 }
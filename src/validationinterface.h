@@ -6,27 +6,42 @@
 #ifndef SOV_VALIDATIONINTERFACE_H
 #define SOV_VALIDATIONINTERFACE_H
 
-#include <boost/signals2/signal.hpp>
+#include "primitives/transaction.h"
+
 #include <boost/shared_ptr.hpp>
+#include <memory>
+#include <vector>
 
 class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
 class CReserveScript;
-class CTransaction;
+class CScheduler;
 class CValidationInterface;
 class CValidationState;
+struct ChainSignals;
 class uint256;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. Background listeners get the
+ * chain and mempool events from the background queue, the others get them
+ * right away on the thread that raised them.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fBackground = false);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/**
+ * Wait until all notifications queued before this call have been handled.
+ * Must not be called with cs_main (or any lock a listener takes) held.
+ * Returns immediately if notifications are delivered synchronously or the
+ * background scheduler has stopped.
+ */
+void SyncWithValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
@@ -34,6 +49,8 @@ protected:
     virtual void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) {}
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
+    virtual void BlockConnected(const CBlock &block, const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const CBlock &block, const CBlockIndex *pindex) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
@@ -42,36 +59,83 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend struct ::ChainSignals;
 };
 
-struct CMainSignals {
+struct MainSignalsInstance;
+
+/**
+ * Dispatches validation events to the registered CValidationInterfaces.
+ *
+ * Once a background scheduler is registered, the events marked "queued" below
+ * are handed to the background listeners (wallet, ZMQ) in order on the
+ * scheduler thread instead of the thread that raised them (often while holding
+ * cs_main). Those listeners then get immutable snapshots: the shared
+ * transactions and block are kept alive until every listener has seen them,
+ * and CBlockIndex entries are never freed while running. The other listeners
+ * still get every event synchronously, and so do all listeners for the events
+ * whose caller needs their answer right away.
+ */
+class CMainSignals {
+private:
+    std::unique_ptr<MainSignalsInstance> m_internals;
+
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
+    friend void ::UnregisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterAllValidationInterfaces();
+    friend void ::SyncWithValidationInterfaceQueue();
+
+public:
+    CMainSignals();
+    ~CMainSignals();
+
+    /** Register a CScheduler to give callbacks which should run in the background */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Unregister a CScheduler; queued events are delivered synchronously again */
+    void UnregisterBackgroundSignalScheduler();
+    /** Deliver any queued notifications, on the calling thread if the scheduler threads have stopped */
+    void FlushBackgroundCallbacks();
+    /** Number of queued events not yet handed to listeners */
+    size_t CallbacksPending();
+
     /** Notifies listeners of accepted block header */
-    boost::signals2::signal<void (const CBlockIndex *)> AcceptedBlockHeader;
+    void AcceptedBlockHeader(const CBlockIndex *pindexNew);
     /** Notifies listeners of updated block header tip */
-    boost::signals2::signal<void (const CBlockIndex *, bool fInitialDownload)> NotifyHeaderTip;
-    /** Notifies listeners of updated block chain tip */
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
-    /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
-    boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
-    /** Notifies listeners of an updated transaction lock without new data. */
-    boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
-    /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
-    boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
-    /** Notifies listeners of a new active block chain. */
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+    void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload);
+    /** Notifies listeners of updated block chain tip (queued) */
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+    /** Notifies listeners of a transaction that entered the mempool (queued) */
+    void SyncTransaction(const CTransactionRef &ptx);
+    /**
+     * Notifies listeners of a block being connected to the active chain, then
+     * of the transactions it removed from the mempool as conflicts and of the
+     * transactions it confirmed (queued).
+     */
+    void BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef> &vtxConflicted);
+    /**
+     * Notifies listeners of a block being disconnected from the active chain,
+     * then of each of its transactions going back to 0 confirmations (queued).
+     */
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex);
+    /** Notifies listeners of an updated transaction lock without new data (queued) */
+    void NotifyTransactionLock(const CTransactionRef &ptx);
+    /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible) (queued) */
+    void UpdatedTransaction(const uint256 &hash);
+    /** Notifies listeners of a new active block chain (queued) */
+    void SetBestChain(const CBlockLocator &locator);
     /** Notifies listeners about an inventory item being seen on the network. */
-    boost::signals2::signal<void (const uint256 &)> Inventory;
+    void Inventory(const uint256 &hash);
     /** Tells listeners to broadcast their data. */
-    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
+    void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     /** Notifies listeners of a block validation result */
-    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    void BlockChecked(const CBlock& block, const CValidationState& state);
     /** Notifies listeners that a key for mining is required (coinbase) */
-    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    void ScriptForMining(boost::shared_ptr<CReserveScript>& coinbaseScript);
     /** Notifies listeners that a block has been successfully mined */
-    boost::signals2::signal<void (const uint256 &)> BlockFound;
+    void BlockFound(const uint256 &hash);
 };
 
 CMainSignals& GetMainSignals();
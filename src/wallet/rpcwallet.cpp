@@ -17,6 +17,7 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "validation.h"
+#include "validationinterface.h"
 #include "wallet.h"
 #include "walletdb.h"
 #include "keepass.h"
@@ -48,6 +49,9 @@ bool EnsureWalletIsAvailable(bool avoidException)
         else
             return false;
     }
+    // Answer from a wallet that has seen every block and transaction
+    // notification queued before this call
+    SyncWithValidationInterfaceQueue();
     return true;
 }
 
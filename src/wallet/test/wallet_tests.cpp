@@ -4,6 +4,13 @@
 
 #include "wallet/wallet.h"
 
+#include "chain.h"
+#include "consensus/consensus.h"
+#include "instantx.h"
+#include "privatesend.h"
+#include "random.h"
+#include "validation.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -23,8 +30,18 @@
 
 using namespace std;
 
+extern CWallet* pwalletMain;
+
 typedef set<pair<const CWalletTx*,unsigned int> > CoinSet;
 
+// forgets the InstantSend locks a test forced, so later tests don't see them
+struct InstantSendTestingSetup : public TestingSetup {
+    ~InstantSendTestingSetup()
+    {
+        instantsend.ClearForTesting();
+    }
+};
+
 BOOST_FIXTURE_TEST_SUITE(wallet_tests, TestingSetup)
 
 static CWallet wallet;
@@ -361,4 +378,248 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+BOOST_AUTO_TEST_CASE(subset_search_truncation)
+{
+    CoinSet setCoinsRet;
+    CAmount nValueRet;
+
+    LOCK(wallet.cs_wallet);
+
+    empty_wallet();
+
+    // Only the largest coins below the target are searched
+    for (unsigned int i = 0; i < MAX_SUBSET_SEARCH_COINS; i++)
+        add_coin(3 * COIN);
+    for (int i = 0; i < 1000; i++)
+        add_coin(2 * COIN);
+
+    BOOST_CHECK(wallet.SelectCoinsMinConf(9 * COIN, 1, 6, vCoins, setCoinsRet, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 9 * COIN);
+    BOOST_FOREACH(const PAIRTYPE(const CWalletTx*, unsigned int)& coin, setCoinsRet)
+        BOOST_CHECK_EQUAL(coin.first->vout[coin.second].nValue, 3 * COIN);
+
+    empty_wallet();
+
+    // More are searched when the largest ones don't cover the target
+    for (unsigned int i = 0; i < MAX_SUBSET_SEARCH_COINS + 100; i++)
+        add_coin(1 * COIN);
+
+    BOOST_CHECK(wallet.SelectCoinsMinConf((MAX_SUBSET_SEARCH_COINS + 50) * COIN, 1, 6, vCoins, setCoinsRet, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, (MAX_SUBSET_SEARCH_COINS + 50) * COIN);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), MAX_SUBSET_SEARCH_COINS + 50);
+
+    empty_wallet();
+}
+
+// Connects a block holding vtx to the wallet. The block only exists in
+// mapBlockIndex and chainActive, on top of the current tip, so wallet
+// transactions can be confirmed and conflicted without validating them.
+// UnloadBlockIndex frees the block index when the test ends.
+static CBlock ConnectFakeBlock(CWallet& wallet, const std::vector<CMutableTransaction>& vtx)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    CBlock block;
+    block.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+    block.nTime = chainActive.Tip()->nTime + 1;
+    block.nNonce = GetRandInt(std::numeric_limits<int>::max());
+    BOOST_FOREACH(const CMutableTransaction& tx, vtx)
+        block.vtx.push_back(MakeTransactionRef(tx));
+
+    CBlockIndex* pindex = new CBlockIndex(block);
+    pindex->pprev = chainActive.Tip();
+    pindex->nHeight = chainActive.Height() + 1;
+    pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first->first;
+    chainActive.SetTip(pindex);
+
+    BOOST_FOREACH(const CTransactionRef& tx, block.vtx)
+        wallet.SyncTransaction(*tx, &block);
+    wallet.UpdatedBlockTip(pindex, pindex->pprev, false);
+    return block;
+}
+
+static CScript AddWalletKey(CWallet& wallet)
+{
+    LOCK(wallet.cs_wallet);
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    return GetScriptForDestination(key.GetPubKey().GetID());
+}
+
+static CMutableTransaction SpendTx(const COutPoint& outpoint, const CScript& scriptPubKey, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(outpoint));
+    tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+    return tx;
+}
+
+// The outputs of ours no wallet transaction spends, from a full scan
+static std::set<COutPoint> ScanWalletUTXO(const CWallet& wallet)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    std::set<COutPoint> setUTXO;
+    BOOST_FOREACH(const PAIRTYPE(const uint256, CWalletTx)& item, wallet.mapWallet) {
+        for (unsigned int i = 0; i < item.second.vout.size(); i++) {
+            if (wallet.IsMine(item.second.vout[i]) && !wallet.IsSpent(item.first, i))
+                setUTXO.insert(COutPoint(item.first, i));
+        }
+    }
+    return setUTXO;
+}
+
+BOOST_AUTO_TEST_CASE(wallet_utxo_index)
+{
+    CPrivateSend::InitStandardDenominations();
+    CWallet& testWallet = *pwalletMain;
+    CScript scriptMine = AddWalletKey(testWallet);
+    CScript scriptOther = GetScriptForDestination(CKeyID(uint160(ParseHex("c5e4fb9171c22409809a3e8047a29c83886e325d"))));
+
+    // Add: a confirmed transaction paying us a denomination and more
+    CMutableTransaction txReceive = SpendTx(COutPoint(GetRandHash(), 0), scriptMine, 5 * COIN);
+    txReceive.vout.push_back(CTxOut(CPrivateSend::GetStandardDenominations().back(), scriptMine));
+    txReceive.vout.push_back(CTxOut(1 * COIN, scriptOther));
+    ConnectFakeBlock(testWallet, std::vector<CMutableTransaction>(1, txReceive));
+    BOOST_CHECK_EQUAL(testWallet.GetWalletUTXO().size(), 2U);
+    BOOST_CHECK(testWallet.GetWalletUTXO() == ScanWalletUTXO(testWallet));
+
+    // Spend: the spent output leaves, the change comes in
+    CMutableTransaction txSpend = SpendTx(COutPoint(txReceive.GetHash(), 0), scriptMine, 3 * COIN);
+    txSpend.vout.push_back(CTxOut(2 * COIN - 10000, scriptOther));
+    testWallet.SyncTransaction(txSpend, NULL);
+    BOOST_CHECK(!testWallet.GetWalletUTXO().count(COutPoint(txReceive.GetHash(), 0)));
+    BOOST_CHECK(testWallet.GetWalletUTXO().count(COutPoint(txSpend.GetHash(), 0)));
+    BOOST_CHECK(testWallet.GetWalletUTXO() == ScanWalletUTXO(testWallet));
+
+    // Abandon: the spent output comes back
+    BOOST_CHECK(testWallet.AbandonTransaction(txSpend.GetHash()));
+    BOOST_CHECK(testWallet.GetWalletUTXO().count(COutPoint(txReceive.GetHash(), 0)));
+    BOOST_CHECK(testWallet.GetWalletUTXO() == ScanWalletUTXO(testWallet));
+
+    // Conflict: a block spends the output of our pending spend elsewhere
+    CMutableTransaction txSpend2 = SpendTx(COutPoint(txReceive.GetHash(), 0), scriptMine, 4 * COIN);
+    testWallet.SyncTransaction(txSpend2, NULL);
+    BOOST_CHECK(!testWallet.GetWalletUTXO().count(COutPoint(txReceive.GetHash(), 0)));
+    BOOST_CHECK(testWallet.GetWalletUTXO() == ScanWalletUTXO(testWallet));
+
+    CMutableTransaction txDoubleSpend = SpendTx(COutPoint(txReceive.GetHash(), 0), scriptOther, 5 * COIN - 10000);
+    ConnectFakeBlock(testWallet, std::vector<CMutableTransaction>(1, txDoubleSpend));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(testWallet.GetWalletTx(txSpend2.GetHash())->GetDepthInMainChain() < 0);
+    }
+    BOOST_CHECK(!testWallet.GetWalletUTXO().count(COutPoint(txReceive.GetHash(), 0)));
+    BOOST_CHECK(testWallet.GetWalletUTXO() == ScanWalletUTXO(testWallet));
+
+    // Rebuilding gives the same index
+    testWallet.MarkDirty();
+    BOOST_CHECK(testWallet.GetWalletUTXO() == ScanWalletUTXO(testWallet));
+}
+
+// The balances of all wallet transactions counted from scratch
+static CWalletBalances ScanWalletBalances(const CWallet& wallet)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    CWalletBalances balances;
+    BOOST_FOREACH(const PAIRTYPE(const uint256, CWalletTx)& item, wallet.mapWallet) {
+        // a copy without any cached amounts
+        CWalletTx wtx(&wallet, (const CMerkleTx&)item.second);
+        balances += wtx.GetBalances();
+    }
+    return balances;
+}
+
+static void CheckWalletBalances(const CWallet& wallet)
+{
+    CWalletBalances balances = wallet.GetBalances();
+    CWalletBalances balancesScanned = ScanWalletBalances(wallet);
+    BOOST_CHECK_EQUAL(balances.nBalance, balancesScanned.nBalance);
+    BOOST_CHECK_EQUAL(balances.nUnconfirmed, balancesScanned.nUnconfirmed);
+    BOOST_CHECK_EQUAL(balances.nImmature, balancesScanned.nImmature);
+    BOOST_CHECK_EQUAL(balances.nWatchOnly, balancesScanned.nWatchOnly);
+    BOOST_CHECK_EQUAL(balances.nUnconfirmedWatchOnly, balancesScanned.nUnconfirmedWatchOnly);
+    BOOST_CHECK_EQUAL(balances.nImmatureWatchOnly, balancesScanned.nImmatureWatchOnly);
+    BOOST_CHECK_EQUAL(balances.nAnonymized, balancesScanned.nAnonymized);
+    BOOST_CHECK_EQUAL(balances.nDenomConf, balancesScanned.nDenomConf);
+    BOOST_CHECK_EQUAL(balances.nDenomUnconf, balancesScanned.nDenomUnconf);
+}
+
+BOOST_FIXTURE_TEST_CASE(wallet_running_balances, InstantSendTestingSetup)
+{
+    CPrivateSend::InitStandardDenominations();
+    CWallet& testWallet = *pwalletMain;
+    CScript scriptMine = AddWalletKey(testWallet);
+    CScript scriptOther = GetScriptForDestination(CKeyID(uint160(ParseHex("c5e4fb9171c22409809a3e8047a29c83886e325d"))));
+    CAmount nDenom = CPrivateSend::GetStandardDenominations().back();
+    TestMemPoolEntryHelper entry;
+    std::list<CTransaction> removed;
+
+    CheckWalletBalances(testWallet);
+
+    // Add: a confirmed transaction paying us a denomination and more
+    CMutableTransaction txReceive = SpendTx(COutPoint(GetRandHash(), 0), scriptMine, 5 * COIN);
+    txReceive.vout.push_back(CTxOut(nDenom, scriptMine));
+    ConnectFakeBlock(testWallet, std::vector<CMutableTransaction>(1, txReceive));
+    BOOST_CHECK_EQUAL(testWallet.GetBalance(), 5 * COIN + nDenom);
+    CheckWalletBalances(testWallet);
+
+    // An unconfirmed payment to us from someone else...
+    CMutableTransaction txUnconfirmed = SpendTx(COutPoint(GetRandHash(), 0), scriptMine, 2 * COIN);
+    mempool.addUnchecked(txUnconfirmed.GetHash(), entry.FromTx(txUnconfirmed));
+    testWallet.SyncTransaction(txUnconfirmed, NULL);
+    BOOST_CHECK_EQUAL(testWallet.GetUnconfirmedBalance(), 2 * COIN);
+    CheckWalletBalances(testWallet);
+
+    // ...becomes trusted once it is locked by InstantSend
+    instantsend.ForceTransactionLockForTesting(CTxLockRequest(txUnconfirmed));
+    testWallet.UpdatedTransaction(txUnconfirmed.GetHash());
+    BOOST_CHECK_EQUAL(testWallet.GetUnconfirmedBalance(), 0);
+    BOOST_CHECK_EQUAL(testWallet.GetBalance(), 7 * COIN + nDenom);
+    CheckWalletBalances(testWallet);
+
+    // Spend: our own change is trusted while the spend is in the mempool
+    CMutableTransaction txSpend = SpendTx(COutPoint(txReceive.GetHash(), 0), scriptMine, 3 * COIN);
+    txSpend.vout.push_back(CTxOut(2 * COIN - 10000, scriptOther));
+    mempool.addUnchecked(txSpend.GetHash(), entry.FromTx(txSpend));
+    testWallet.SyncTransaction(txSpend, NULL);
+    BOOST_CHECK_EQUAL(testWallet.GetBalance(), 5 * COIN + nDenom);
+    CheckWalletBalances(testWallet);
+
+    // Abandon: the spent output counts again
+    mempool.remove(txSpend, removed);
+    CheckWalletBalances(testWallet);
+    BOOST_CHECK(testWallet.AbandonTransaction(txSpend.GetHash()));
+    BOOST_CHECK_EQUAL(testWallet.GetBalance(), 7 * COIN + nDenom);
+    CheckWalletBalances(testWallet);
+
+    // Conflict: a block spends the output of our pending spend elsewhere
+    CMutableTransaction txSpend2 = SpendTx(COutPoint(txReceive.GetHash(), 0), scriptMine, 4 * COIN);
+    mempool.addUnchecked(txSpend2.GetHash(), entry.FromTx(txSpend2));
+    testWallet.SyncTransaction(txSpend2, NULL);
+    CheckWalletBalances(testWallet);
+
+    mempool.remove(txSpend2, removed);
+    CMutableTransaction txDoubleSpend = SpendTx(COutPoint(txReceive.GetHash(), 0), scriptOther, 5 * COIN - 10000);
+    ConnectFakeBlock(testWallet, std::vector<CMutableTransaction>(1, txDoubleSpend));
+    BOOST_CHECK_EQUAL(testWallet.GetBalance(), 2 * COIN + nDenom);
+    CheckWalletBalances(testWallet);
+
+    // Maturity: a coinbase paying us is immature until COINBASE_MATURITY more blocks
+    CMutableTransaction txCoinbase = SpendTx(COutPoint(), scriptMine, 10 * COIN);
+    txCoinbase.vin[0].scriptSig = CScript() << chainActive.Height() + 1 << OP_0;
+    ConnectFakeBlock(testWallet, std::vector<CMutableTransaction>(1, txCoinbase));
+    BOOST_CHECK_EQUAL(testWallet.GetImmatureBalance(), 10 * COIN);
+    CheckWalletBalances(testWallet);
+
+    for (int i = 0; i < COINBASE_MATURITY; i++) {
+        ConnectFakeBlock(testWallet, std::vector<CMutableTransaction>());
+        CheckWalletBalances(testWallet);
+    }
+    BOOST_CHECK_EQUAL(testWallet.GetImmatureBalance(), 0);
+    BOOST_CHECK_EQUAL(testWallet.GetBalance(), 12 * COIN + nDenom);
+
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -701,7 +701,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    RemoveFromWalletUTXO(outpoint);
 
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -709,6 +709,54 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 }
 
 
+WalletUTXOType CWallet::GetWalletUTXOType(CAmount nValue)
+{
+    // same precedence as the nCoinType checks in AvailableCoins
+    if (CPrivateSend::IsDenominatedAmount(nValue)) return UTXO_DENOMINATED;
+    if (CPrivateSend::IsCollateralAmount(nValue)) return UTXO_PRIVATESEND_COLLATERAL;
+    if (nValue == 15000*COIN) return UTXO_1000;
+    return UTXO_NONDENOMINATED;
+}
+
+void CWallet::AddToWalletUTXO(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) && !IsSpent(hash, i)) {
+            mapWalletUTXO[GetWalletUTXOType(wtx.vout[i].nValue)].insert(COutPoint(hash, i));
+        }
+    }
+}
+
+void CWallet::RemoveFromWalletUTXO(const COutPoint& outpoint)
+{
+    std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+    if (mi == mapWallet.end() || outpoint.n >= mi->second.vout.size())
+        return;
+    WalletUTXOType nType = GetWalletUTXOType(mi->second.vout[outpoint.n].nValue);
+    std::map<WalletUTXOType, std::set<COutPoint> >::iterator it = mapWalletUTXO.find(nType);
+    if (it != mapWalletUTXO.end())
+        it->second.erase(outpoint);
+}
+
+void CWallet::RebuildWalletUTXO()
+{
+    AssertLockHeld(cs_wallet);
+    mapWalletUTXO.clear();
+    BOOST_FOREACH(const PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
+        AddToWalletUTXO(item.second);
+}
+
+std::set<COutPoint> CWallet::GetWalletUTXO() const
+{
+    LOCK(cs_wallet);
+    std::set<COutPoint> setUTXO;
+    for (std::map<WalletUTXOType, std::set<COutPoint> >::const_iterator it = mapWalletUTXO.begin(); it != mapWalletUTXO.end(); ++it)
+        setUTXO.insert(it->second.begin(), it->second.end());
+    return setUTXO;
+}
+
 void CWallet::AddToSpends(const uint256& wtxid)
 {
     assert(mapWallet.count(wtxid));
@@ -868,9 +916,14 @@ int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb)
 void CWallet::MarkDirty()
 {
     {
-        LOCK(cs_wallet);
+        LOCK2(cs_main, cs_wallet);
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
+        // recount everything instead of tracking each transaction
+        fBalancesValid = false;
+        setBalancesDirty.clear();
+        // imported keys and scripts can make more outputs ours
+        RebuildWalletUTXO();
     }
 
     fAnonymizableTallyCached = false;
@@ -956,11 +1009,6 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
-            for(int i = 0; i < wtx.vout.size(); ++i) {
-                if (IsMine(wtx.vout[i]) && !IsSpent(hash, i)) {
-                    setWalletUTXO.insert(COutPoint(hash, i));
-                }
-            }
         }
 
         bool fUpdated = false;
@@ -1001,6 +1049,10 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         // Break debit/credit balance caches:
         wtx.MarkDirty();
 
+        // A new transaction adds outputs, an updated one may have left the
+        // conflicted state its outputs were skipped in
+        AddToWalletUTXO(wtx);
+
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -1112,8 +1164,11 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
-                    mapWallet[txin.prevout.hash].MarkDirty();
+                if (mapWallet.count(txin.prevout.hash)) {
+                    CWalletTx& prevtx = mapWallet[txin.prevout.hash];
+                    prevtx.MarkDirty();
+                    AddToWalletUTXO(prevtx);
+                }
             }
         }
     }
@@ -1176,8 +1231,11 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
-                    mapWallet[txin.prevout.hash].MarkDirty();
+                if (mapWallet.count(txin.prevout.hash)) {
+                    CWalletTx& prevtx = mapWallet[txin.prevout.hash];
+                    prevtx.MarkDirty();
+                    AddToWalletUTXO(prevtx);
+                }
             }
         }
     }
@@ -1186,6 +1244,26 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
     fAnonymizableTallyCachedNonDenom = false;
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    LOCK(cs_wallet);
+
+    // Depth, maturity and conflicts of these changed without the transactions
+    // being touched. A spend that is no longer conflicted makes its inputs
+    // spent again, so recount those too.
+    BOOST_FOREACH(const uint256& hash, setBalancesVolatile) {
+        map<uint256, CWalletTx>::iterator mi = mapWallet.find(hash);
+        if (mi == mapWallet.end())
+            continue;
+        BOOST_FOREACH(const CTxIn& txin, mi->second.vin) {
+            map<uint256, CWalletTx>::iterator miPrev = mapWallet.find(txin.prevout.hash);
+            if (miPrev != mapWallet.end())
+                miPrev->second.MarkDirty();
+        }
+        MarkBalancesDirty(hash);
+    }
+}
+
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
     LOCK2(cs_main, cs_wallet);
@@ -1701,9 +1779,9 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 
             CBlock block;
             ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            BOOST_FOREACH(const CTransactionRef& ptx, block.vtx)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                if (AddToWalletIfInvolvingMe(*ptx, &block, fUpdate))
                     ret++;
             }
             pindex = chainActive.Next(pindex);
@@ -1782,6 +1860,25 @@ set<uint256> CWalletTx::GetConflicts() const
     return result;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fAnonymizedCreditCached = false;
+    fDenomUnconfCreditCached = false;
+    fDenomConfCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    if (pwallet)
+        pwallet->MarkBalancesDirty(GetHash());
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 {
     if (vin.empty())
@@ -2012,6 +2109,38 @@ CAmount CWalletTx::GetDenominatedCredit(bool unconfirmed, bool fUseCache) const
     return nCredit;
 }
 
+CWalletBalances CWalletTx::GetBalances() const
+{
+    CWalletBalances balances;
+    if (pwallet == 0)
+        return balances;
+
+    bool fTrusted = IsTrusted();
+    if (fTrusted) {
+        balances.nBalance = GetAvailableCredit();
+        balances.nWatchOnly = GetAvailableWatchOnlyCredit();
+    } else if (GetDepthInMainChain() == 0 && InMempool()) {
+        balances.nUnconfirmed = GetAvailableCredit();
+        balances.nUnconfirmedWatchOnly = GetAvailableWatchOnlyCredit();
+    }
+    balances.nImmature = GetImmatureCredit();
+    balances.nImmatureWatchOnly = GetImmatureWatchOnlyCredit();
+
+    if (!fLiteMode) {
+        if (fTrusted)
+            balances.nAnonymized = GetAnonymizedCredit();
+        balances.nDenomConf = GetDenominatedCredit(false);
+        balances.nDenomUnconf = GetDenominatedCredit(true);
+    }
+    return balances;
+}
+
+bool CWalletTx::IsBalanceVolatile() const
+{
+    // InstantSend locks are reported through UpdatedTransaction, ignore them here
+    return GetDepthInMainChain(false) <= 0 || GetBlocksToMaturity() > 0;
+}
+
 CAmount CWalletTx::GetChange() const
 {
     if (fChangeCached)
@@ -2128,20 +2257,91 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+void CWallet::MarkBalancesDirty(const uint256& hashTx) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
+    // everything is recounted anyway until the totals are built
+    if (fBalancesValid)
+        setBalancesDirty.insert(hashTx);
+}
+
+bool CWallet::IsBalanceUpdateNeeded() const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!fBalancesValid || !setBalancesDirty.empty())
+        return true;
+    if (nBalancesPrivateSendRounds != privateSendClient.nPrivateSendRounds)
+        return true;
+    return !setBalancesVolatile.empty() && nBalancesMempoolUpdated != mempool.GetTransactionsUpdated();
+}
+
+void CWallet::UpdateBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    // read it first, changes made while we count are picked up next time
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+
+    std::set<uint256> setRecount;
+    if (!fBalancesValid || nBalancesPrivateSendRounds != privateSendClient.nPrivateSendRounds) {
+        balances.SetNull();
+        mapBalancesCounted.clear();
+        setBalancesVolatile.clear();
+        setBalancesDirty.clear();
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+            setRecount.insert(setRecount.end(), it->first);
+    } else {
+        setRecount.swap(setBalancesDirty);
+        // trust and unconfirmed balance depend on what is in the mempool
+        if (nMempoolUpdated != nBalancesMempoolUpdated)
+            setRecount.insert(setBalancesVolatile.begin(), setBalancesVolatile.end());
+    }
+
+    BOOST_FOREACH(const uint256& hash, setRecount) {
+        std::map<uint256, CWalletBalances>::iterator itCounted = mapBalancesCounted.find(hash);
+        if (itCounted != mapBalancesCounted.end()) {
+            balances -= itCounted->second;
+            mapBalancesCounted.erase(itCounted);
+        }
+        setBalancesVolatile.erase(hash);
+
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx& wtx = it->second;
+
+        CWalletBalances txBalances = wtx.GetBalances();
+        if (!txBalances.IsNull()) {
+            balances += txBalances;
+            mapBalancesCounted.insert(std::make_pair(hash, txBalances));
         }
+        if (wtx.IsBalanceVolatile())
+            setBalancesVolatile.insert(hash);
     }
 
-    return nTotal;
+    fBalancesValid = true;
+    nBalancesMempoolUpdated = nMempoolUpdated;
+    nBalancesPrivateSendRounds = privateSendClient.nPrivateSendRounds;
+}
+
+CWalletBalances CWallet::GetBalances() const
+{
+    {
+        LOCK(cs_wallet);
+        if (!IsBalanceUpdateNeeded())
+            return balances;
+    }
+
+    LOCK2(cs_main, cs_wallet);
+    UpdateBalances();
+    return balances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nBalance;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -2170,23 +2370,7 @@ CAmount CWallet::GetAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
-    LOCK2(cs_main, cs_wallet);
-
-    std::set<uint256> setWalletTxesCounted;
-    for (auto& outpoint : setWalletUTXO) {
-
-        if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
-        setWalletTxesCounted.insert(outpoint.hash);
-
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash); it != mapWallet.end() && it->first == outpoint.hash; ++it) {
-            if (it->second.IsTrusted())
-                nTotal += it->second.GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymized;
 }
 
 // Note: calculated including unconfirmed,
@@ -2199,9 +2383,10 @@ float CWallet::GetAverageAnonymizedRounds() const
     int nCount = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (auto& outpoint : setWalletUTXO) {
-        if(!IsDenominated(outpoint)) continue;
+    auto itUTXO = mapWalletUTXO.find(UTXO_DENOMINATED);
+    if (itUTXO == mapWalletUTXO.end()) return 0;
 
+    for (auto& outpoint : itUTXO->second) {
         nTotal += GetOutpointPrivateSendRounds(outpoint);
         nCount++;
     }
@@ -2220,10 +2405,12 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
     CAmount nTotal = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (auto& outpoint : setWalletUTXO) {
+    auto itUTXO = mapWalletUTXO.find(UTXO_DENOMINATED);
+    if (itUTXO == mapWalletUTXO.end()) return 0;
+
+    for (auto& outpoint : itUTXO->second) {
         map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
         if (it == mapWallet.end()) continue;
-        if (!IsDenominated(outpoint)) continue;
         if (it->second.GetDepthInMainChain() < 0) continue;
 
         int nRounds = GetOutpointPrivateSendRounds(outpoint);
@@ -2261,92 +2448,33 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    CWalletBalances walletBalances = GetBalances();
+    return unconfirmed ? walletBalances.nDenomUnconf : walletBalances.nDenomConf;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureWatchOnly;
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2355,31 +2483,76 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+        // Only visit the buckets of the wallet UTXO index this coin type can
+        // be found in instead of every output of every wallet transaction
+        std::vector<WalletUTXOType> vecTypes;
+        if(nCoinType == ONLY_DENOMINATED) {
+            vecTypes.push_back(UTXO_DENOMINATED);
+        } else if(nCoinType == ONLY_NONDENOMINATED) {
+            vecTypes.push_back(UTXO_NONDENOMINATED);
+            vecTypes.push_back(UTXO_1000);
+        } else if(nCoinType == ONLY_1000) {
+            vecTypes.push_back(UTXO_1000);
+        } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+            vecTypes.push_back(UTXO_PRIVATESEND_COLLATERAL);
+        } else {
+            vecTypes.push_back(UTXO_NONDENOMINATED);
+            vecTypes.push_back(UTXO_DENOMINATED);
+            vecTypes.push_back(UTXO_1000);
+            vecTypes.push_back(UTXO_PRIVATESEND_COLLATERAL);
+        }
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
+        BOOST_FOREACH(WalletUTXOType nType, vecTypes)
+        {
+            std::map<WalletUTXOType, std::set<COutPoint> >::const_iterator itUTXO = mapWalletUTXO.find(nType);
+            if (itUTXO == mapWalletUTXO.end())
                 continue;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+            // Outpoints are ordered by txid, so the transaction level checks
+            // below only run once for all outputs of the same transaction
+            uint256 hashLast;
+            const CWalletTx* pcoin = NULL;
+            int nDepth = 0;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-                continue;
+            BOOST_FOREACH(const COutPoint& outpoint, itUTXO->second)
+            {
+                const uint256& wtxid = outpoint.hash;
+                unsigned int i = outpoint.n;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                if (wtxid != hashLast) {
+                    hashLast = wtxid;
+                    pcoin = NULL;
+
+                    map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                    if (it == mapWallet.end())
+                        continue;
+                    const CWalletTx* ptx = &(*it).second;
+
+                    if (!CheckFinalTx(*ptx))
+                        continue;
+
+                    if (fOnlyConfirmed && !ptx->IsTrusted())
+                        continue;
+
+                    if (ptx->IsCoinBase() && ptx->GetBlocksToMaturity() > 0)
+                        continue;
+
+                    nDepth = ptx->GetDepthInMainChain(false);
+                    // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+                    if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+                        continue;
+
+                    // We should not consider coins which aren't at least in our mempool
+                    // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                    if (nDepth == 0 && !ptx->InMempool())
+                        continue;
+
+                    pcoin = ptx;
+                }
+                if (pcoin == NULL)
+                    continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 bool found = false;
                 if(nCoinType == ONLY_DENOMINATED) {
                     found = CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
@@ -2397,9 +2570,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
+                    (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_1000) &&
                     (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint((*it).first, i))))
+                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(outpoint)))
                         vCoins.push_back(COutput(pcoin, i, nDepth,
                                                  ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                                                   (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
@@ -2577,6 +2750,21 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
 
     // Solve subset sum by stochastic approximation
     sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
+
+    // Every pass of the approximation walks all candidates, on wallets with
+    // a huge number of small coins only search among the largest ones
+    if (vValue.size() > MAX_SUBSET_SEARCH_COINS)
+    {
+        CAmount nCoverValue = nTotalLower >= nTargetValue + MIN_CHANGE ? nTargetValue + MIN_CHANGE : nTargetValue;
+        CAmount nTotalKept = 0;
+        unsigned int nKept = 0;
+        while (nKept < vValue.size() && (nKept < MAX_SUBSET_SEARCH_COINS || nTotalKept < nCoverValue))
+            nTotalKept += vValue[nKept++].first;
+        LogPrint("selectcoins", "SelectCoinsMinConf: searching %d of %d coins\n", nKept, vValue.size());
+        vValue.resize(nKept);
+        nTotalLower = nTotalKept;
+    }
+
     vector<char> vfBest;
     CAmount nBest;
 
@@ -2840,13 +3028,14 @@ bool CWallet::SelectCoinsGrouppedByAddresses(std::vector<CompactTallyItem>& vecT
 
     // Tally
     map<CTxDestination, CompactTallyItem> mapTally;
-    std::set<uint256> setWalletTxesCounted;
-    for (auto& outpoint : setWalletUTXO) {
+    std::set<uint256> setWalletTxes;
+    for (auto& pairUTXO : mapWalletUTXO)
+        for (auto& outpoint : pairUTXO.second)
+            setWalletTxes.insert(outpoint.hash);
 
-        if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
-        setWalletTxesCounted.insert(outpoint.hash);
+    for (auto& hash : setWalletTxes) {
 
-        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
         if (it == mapWallet.end()) continue;
 
         const CWalletTx& wtx = (*it).second;
@@ -2861,7 +3050,7 @@ bool CWallet::SelectCoinsGrouppedByAddresses(std::vector<CompactTallyItem>& vecT
             isminefilter mine = ::IsMine(*this, txdest);
             if(!(mine & filter)) continue;
 
-            if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
+            if(IsSpent(hash, i) || IsLockedCoin(hash, i)) continue;
 
             if(fSkipDenominated && CPrivateSend::IsDenominatedAmount(wtx.vout[i].nValue)) continue;
 
@@ -2873,13 +3062,13 @@ bool CWallet::SelectCoinsGrouppedByAddresses(std::vector<CompactTallyItem>& vecT
                 // otherwise they will just lead to higher fee / lower priority
                 if(wtx.vout[i].nValue <= nSmallestDenom/10) continue;
                 // ignore anonymized
-                if(GetOutpointPrivateSendRounds(COutPoint(outpoint.hash, i)) >= privateSendClient.nPrivateSendRounds) continue;
+                if(GetOutpointPrivateSendRounds(COutPoint(hash, i)) >= privateSendClient.nPrivateSendRounds) continue;
             }
 
             CompactTallyItem& item = mapTally[txdest];
             item.txdest = txdest;
             item.nAmount += wtx.vout[i].nValue;
-            item.vecTxIn.push_back(CTxIn(outpoint.hash, i));
+            item.vecTxIn.push_back(CTxIn(hash, i));
         }
     }
 
@@ -3614,13 +3803,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (auto& pair : mapWallet) {
-            for(int i = 0; i < pair.second.vout.size(); ++i) {
-                if (IsMine(pair.second.vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
-                }
-            }
-        }
+        RebuildWalletUTXO();
     }
 
     if (nLoadWalletRet != DB_LOAD_OK)
@@ -4149,8 +4332,10 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
     {
         LOCK(cs_wallet);
         // Only notify UI if this transaction is in this wallet
-        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
+        map<uint256, CWalletTx>::iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()){
+            // a new lock makes the transaction trusted
+            mi->second.MarkDirty();
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -4372,7 +4557,7 @@ int CMerkleTx::SetMerkleBranch(const CBlock& block)
 
     // Locate the transaction
     for (nIndex = 0; nIndex < (int)block.vtx.size(); nIndex++)
-        if (block.vtx[nIndex] == *(CTransaction*)this)
+        if (*block.vtx[nIndex] == *(CTransaction*)this)
             break;
     if (nIndex == (int)block.vtx.size())
     {
@@ -4436,5 +4621,5 @@ int CMerkleTx::GetBlocksToMaturity() const
 bool CMerkleTx::AcceptToMemoryPool(bool fLimitFree, bool fRejectAbsurdFee)
 {
     CValidationState state;
-    return ::AcceptToMemoryPool(mempool, state, *this, fLimitFree, NULL, false, fRejectAbsurdFee);
+    return ::AcceptToMemoryPool(mempool, state, MakeTransactionRef(*this), fLimitFree, NULL, false, fRejectAbsurdFee);
 }
@@ -54,6 +54,8 @@ static const CAmount DEFAULT_TRANSACTION_MINFEE = 1000;
 static const CAmount DEFAULT_TRANSACTION_MAXFEE = 0.2 * COIN; // "smallest denom" + X * "denom tails"
 //! minimum change amount
 static const CAmount MIN_CHANGE = CENT;
+//! Coins below the target the stochastic subset search looks at, largest first
+static const unsigned int MAX_SUBSET_SEARCH_COINS = 5000;
 //! Default for -spendzeroconfchange
 static const bool DEFAULT_SPEND_ZEROCONF_CHANGE = true;
 //! Default for -sendfreetransactions
@@ -99,6 +101,15 @@ enum AvailableCoinsType
     ONLY_PRIVATESEND_COLLATERAL
 };
 
+/** Buckets of the wallet UTXO index, one lookup per AvailableCoinsType */
+enum WalletUTXOType
+{
+    UTXO_NONDENOMINATED,
+    UTXO_DENOMINATED,
+    UTXO_1000, // masternode collateral amount
+    UTXO_PRIVATESEND_COLLATERAL
+};
+
 struct CompactTallyItem
 {
     CTxDestination txdest;
@@ -110,6 +121,67 @@ struct CompactTallyItem
     }
 };
 
+/** Amounts behind the CWallet::Get*Balance() calls, per transaction or for the whole wallet */
+struct CWalletBalances
+{
+    CAmount nBalance;                   //! trusted
+    CAmount nUnconfirmed;               //! untrusted, in mempool
+    CAmount nImmature;                  //! immature coinbase
+    CAmount nWatchOnly;
+    CAmount nUnconfirmedWatchOnly;
+    CAmount nImmatureWatchOnly;
+    CAmount nAnonymized;
+    CAmount nDenomConf;
+    CAmount nDenomUnconf;
+
+    CWalletBalances()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nBalance = nUnconfirmed = nImmature = 0;
+        nWatchOnly = nUnconfirmedWatchOnly = nImmatureWatchOnly = 0;
+        nAnonymized = nDenomConf = nDenomUnconf = 0;
+    }
+
+    bool IsNull() const
+    {
+        return nBalance == 0 && nUnconfirmed == 0 && nImmature == 0 &&
+               nWatchOnly == 0 && nUnconfirmedWatchOnly == 0 && nImmatureWatchOnly == 0 &&
+               nAnonymized == 0 && nDenomConf == 0 && nDenomUnconf == 0;
+    }
+
+    CWalletBalances& operator+=(const CWalletBalances& b)
+    {
+        nBalance += b.nBalance;
+        nUnconfirmed += b.nUnconfirmed;
+        nImmature += b.nImmature;
+        nWatchOnly += b.nWatchOnly;
+        nUnconfirmedWatchOnly += b.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly += b.nImmatureWatchOnly;
+        nAnonymized += b.nAnonymized;
+        nDenomConf += b.nDenomConf;
+        nDenomUnconf += b.nDenomUnconf;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& b)
+    {
+        nBalance -= b.nBalance;
+        nUnconfirmed -= b.nUnconfirmed;
+        nImmature -= b.nImmature;
+        nWatchOnly -= b.nWatchOnly;
+        nUnconfirmedWatchOnly -= b.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly -= b.nImmatureWatchOnly;
+        nAnonymized -= b.nAnonymized;
+        nDenomConf -= b.nDenomConf;
+        nDenomUnconf -= b.nDenomUnconf;
+        return *this;
+    }
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -406,21 +478,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fAnonymizedCreditCached = false;
-        fDenomUnconfCreditCached = false;
-        fDenomConfCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -440,6 +498,11 @@ public:
     CAmount GetAnonymizedCredit(bool fUseCache=true) const;
     CAmount GetDenominatedCredit(bool unconfirmed, bool fUseCache=true) const;
 
+    //! what this transaction adds to each of the wallet balances
+    CWalletBalances GetBalances() const;
+    //! can GetBalances() change without the transaction being marked dirty (unconfirmed, conflicted or immature)?
+    bool IsBalanceVolatile() const;
+
     void GetAmounts(std::list<COutputEntry>& listReceived,
                     std::list<COutputEntry>& listSent, CAmount& nFee, std::string& strSentAccount, const isminefilter& filter) const;
 
@@ -642,7 +705,35 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
-    std::set<COutPoint> setWalletUTXO;
+    /**
+     * Outputs of ours which no wallet transaction spends, bucketed by
+     * WalletUTXOType and ordered by txid within a bucket. Outputs leave the
+     * index when a spend is added and come back when that spend gets
+     * conflicted or abandoned. A conflicted spend that confirms again does
+     * not take them out, so users must still check IsSpent().
+     */
+    std::map<WalletUTXOType, std::set<COutPoint> > mapWalletUTXO;
+    static WalletUTXOType GetWalletUTXOType(CAmount nValue);
+    void AddToWalletUTXO(const CWalletTx& wtx);
+    void RemoveFromWalletUTXO(const COutPoint& outpoint);
+    void RebuildWalletUTXO();
+
+    /**
+     * Running totals behind the Get*Balance() calls and what each transaction
+     * added to them (only non-zero contributions are kept). Transactions marked
+     * dirty are recounted by UpdateBalances(), volatile ones are marked dirty
+     * on every new tip and recounted whenever the mempool changed.
+     */
+    mutable CWalletBalances balances;
+    mutable std::map<uint256, CWalletBalances> mapBalancesCounted;
+    mutable std::set<uint256> setBalancesDirty;
+    mutable std::set<uint256> setBalancesVolatile;
+    mutable bool fBalancesValid;
+    mutable unsigned int nBalancesMempoolUpdated;
+    mutable int nBalancesPrivateSendRounds;
+
+    bool IsBalanceUpdateNeeded() const;
+    void UpdateBalances() const;
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
@@ -724,6 +815,13 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        balances.SetNull();
+        mapBalancesCounted.clear();
+        setBalancesDirty.clear();
+        setBalancesVolatile.clear();
+        fBalancesValid = false;
+        nBalancesMempoolUpdated = 0;
+        nBalancesPrivateSendRounds = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -757,6 +855,11 @@ public:
      */
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed=true, const CCoinControl *coinControl = NULL, bool fIncludeZeroValue=false, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false) const;
 
+    /**
+     * Outpoints in the wallet UTXO index, of every coin type.
+     */
+    std::set<COutPoint> GetWalletUTXO() const;
+
     /**
      * Shuffle and select coins until nTargetValue is reached while avoiding
      * small change; This method is stochastic for some inputs and upon
@@ -854,13 +957,17 @@ public:
     int64_t IncOrderPosNext(CWalletDB *pwalletdb = NULL);
 
     void MarkDirty();
+    //! have the balance totals recount this transaction on their next use
+    void MarkBalancesDirty(const uint256& hashTx) const;
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    CWalletBalances GetBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
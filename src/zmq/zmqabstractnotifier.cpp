@@ -11,7 +11,14 @@ CZMQAbstractNotifier::~CZMQAbstractNotifier()
     assert(!psocket);
 }
 
-bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/)
+void CZMQAbstractNotifier::GetInfo(CZMQNotifierInfo &info) const
+{
+    info.type = type;
+    info.address = address;
+    info.outbound_message_high_water_mark = outbound_message_high_water_mark;
+}
+
+bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/, const CBlock &/*block*/)
 {
     return true;
 }
@@ -7,15 +7,38 @@
 
 #include "zmqconfig.h"
 
+#include <stdint.h>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+/** Default number of messages a notifier queues per subscriber before dropping new ones (ZMQ_SNDHWM) */
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
+/** Copy of the settings and send statistics of a notifier, see getzmqnotifications */
+struct CZMQNotifierInfo
+{
+    std::string type;
+    std::string address;
+    int outbound_message_high_water_mark;
+
+    // send statistics, only kept by publishers
+    bool fHasStats;
+    uint64_t nMessagesSent;
+    uint64_t nBytesSent;
+    uint64_t nSendFailures;
+    int64_t nSendTimeTotal; // microseconds
+    int64_t nSendTimeMax;   // microseconds
+
+    CZMQNotifierInfo() : outbound_message_high_water_mark(0), fHasStats(false), nMessagesSent(0), nBytesSent(0), nSendFailures(0), nSendTimeTotal(0), nSendTimeMax(0) { }
+};
+
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    CZMQAbstractNotifier() : psocket(0), outbound_message_high_water_mark(DEFAULT_ZMQ_SNDHWM) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -28,11 +51,20 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    int GetOutboundMessageHighWaterMark() const { return outbound_message_high_water_mark; }
+    void SetOutboundMessageHighWaterMark(const int sndhwm) {
+        if (sndhwm >= 0) {
+            outbound_message_high_water_mark = sndhwm;
+        }
+    }
+
+    virtual void GetInfo(CZMQNotifierInfo &info) const;
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    // Called with the new tip and the block connected for it, already in memory
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const CBlock &block);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
 
@@ -40,6 +72,7 @@ protected:
     void *psocket;
     std::string type;
     std::string address;
+    int outbound_message_high_water_mark; // aka SNDHWM
 };
 
 #endif // SOV_ZMQ_ZMQABSTRACTNOTIFIER_H
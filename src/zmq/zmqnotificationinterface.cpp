@@ -5,17 +5,21 @@
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
 
+#include "chainparams.h"
 #include "version.h"
 #include "validation.h"
 #include "streams.h"
 #include "util.h"
+#include "utilstrencodings.h"
+
+CZMQNotificationInterface* pzmqNotificationInterface = NULL;
 
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), pindexLastConnected(NULL)
 {
 }
 
@@ -29,6 +33,18 @@ CZMQNotificationInterface::~CZMQNotificationInterface()
     }
 }
 
+std::list<CZMQNotifierInfo> CZMQNotificationInterface::GetActiveNotifiers()
+{
+    LOCK(cs_notifiers);
+    std::list<CZMQNotifierInfo> result;
+    for (std::list<CZMQAbstractNotifier*>::const_iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        result.push_back(CZMQNotifierInfo());
+        (*i)->GetInfo(result.back());
+    }
+    return result;
+}
+
 CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const std::map<std::string, std::string> &args)
 {
     CZMQNotificationInterface* notificationInterface = NULL;
@@ -52,6 +68,11 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(i->first);
             notifier->SetAddress(address);
+            std::map<std::string, std::string>::const_iterator k = args.find("-zmq" + i->first + "hwm");
+            if (k!=args.end())
+            {
+                notifier->SetOutboundMessageHighWaterMark(atoi(k->second));
+            }
             notifiers.push_back(notifier);
         }
     }
@@ -126,15 +147,37 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
+void CZMQNotificationInterface::BlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    blockLastConnected = block;
+    pindexLastConnected = pindex;
+}
+
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
         return;
 
+    // The tip is announced after it was connected, so the block is normally
+    // the one we just kept. Only read it back if we missed the connection.
+    const CBlock *pblock = &blockLastConnected;
+    CBlock blockFromDisk;
+    if (pindexLastConnected != pindexNew)
+    {
+        LOCK(cs_main);
+        if (!ReadBlockFromDisk(blockFromDisk, pindexNew, Params().GetConsensus()))
+        {
+            zmqError("Can't read block from disk");
+            return;
+        }
+        pblock = &blockFromDisk;
+    }
+
+    LOCK(cs_notifiers);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notifier->NotifyBlock(pindexNew, *pblock))
         {
             i++;
         }
@@ -148,6 +191,7 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
+    LOCK(cs_notifiers);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
@@ -165,6 +209,7 @@ void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CB
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
 {
+    LOCK(cs_notifiers);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
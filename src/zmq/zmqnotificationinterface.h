@@ -5,18 +5,25 @@
 #ifndef SOV_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define SOV_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "primitives/block.h"
+#include "sync.h"
 #include "validationinterface.h"
+#include <list>
 #include <string>
 #include <map>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+struct CZMQNotifierInfo;
 
 class CZMQNotificationInterface : public CValidationInterface
 {
 public:
     virtual ~CZMQNotificationInterface();
 
+    // Copies, the notifiers themselves may be shut down and freed at any time
+    std::list<CZMQNotifierInfo> GetActiveNotifiers();
+
     static CZMQNotificationInterface* CreateWithArguments(const std::map<std::string, std::string> &args);
 
 protected:
@@ -25,6 +32,7 @@ protected:
 
     // CValidationInterface
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
+    void BlockConnected(const CBlock &block, const CBlockIndex *pindex);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     void NotifyTransactionLock(const CTransaction &tx);
 
@@ -32,7 +40,17 @@ private:
     CZMQNotificationInterface();
 
     void *pcontext;
+
+    // Guards the list against RPC while notifiers are shut down on failure
+    CCriticalSection cs_notifiers;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    // The last block connected to the chain, kept so the tip can be published
+    // without reading it back from disk. Its transactions are shared, not copied.
+    CBlock blockLastConnected;
+    const CBlockIndex *pindexLastConnected;
 };
 
+extern CZMQNotificationInterface* pzmqNotificationInterface;
+
 #endif // SOV_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -7,6 +7,8 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <atomic>
+
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
@@ -14,7 +16,18 @@ class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 private:
     uint32_t nSequence; // upcounting per message sequence number
 
+    // Send statistics for this notifier's topic. Written only by the thread
+    // delivering notifications, read by RPC.
+    std::atomic<uint64_t> nMessagesSent;
+    std::atomic<uint64_t> nBytesSent;
+    std::atomic<uint64_t> nSendFailures;
+    std::atomic<int64_t> nSendTimeTotal; // microseconds
+    std::atomic<int64_t> nSendTimeMax;   // microseconds
+
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0), nMessagesSent(0), nBytesSent(0), nSendFailures(0), nSendTimeTotal(0), nSendTimeMax(0) { }
+
+    void GetInfo(CZMQNotifierInfo &info) const;
 
     /* send zmq multipart message
        parts:
@@ -31,7 +44,7 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock &block);
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -49,7 +62,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock &block);
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
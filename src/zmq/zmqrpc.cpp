@@ -0,0 +1,73 @@
+// Copyright (c) 2018 The SOV Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "zmq/zmqabstractnotifier.h"
+#include "zmq/zmqnotificationinterface.h"
+
+#include <univalue.h>
+
+using namespace std;
+
+UniValue getzmqnotifications(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns information about the active ZeroMQ notifications.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"type\": \"pubhashtx\",          (string) Type of notification\n"
+            "    \"address\": \"...\",             (string) Address of the publisher\n"
+            "    \"hwm\": n,                     (numeric) Outbound message high water mark\n"
+            "    \"messages\": n,                (numeric) Messages sent on this topic\n"
+            "    \"bytes\": n,                   (numeric) Payload bytes sent on this topic\n"
+            "    \"failures\": n,                (numeric) Messages that could not be sent\n"
+            "    \"sendtimeavg\": n,             (numeric) Average time spent sending a message, in microseconds\n"
+            "    \"sendtimemax\": n              (numeric) Longest time spent sending a message, in microseconds\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    if (pzmqNotificationInterface != NULL) {
+        std::list<CZMQNotifierInfo> notifiers = pzmqNotificationInterface->GetActiveNotifiers();
+        for (std::list<CZMQNotifierInfo>::const_iterator it = notifiers.begin(); it != notifiers.end(); ++it) {
+            const CZMQNotifierInfo &n = *it;
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("type", n.type));
+            obj.push_back(Pair("address", n.address));
+            obj.push_back(Pair("hwm", n.outbound_message_high_water_mark));
+            if (n.fHasStats) {
+                obj.push_back(Pair("messages", n.nMessagesSent));
+                obj.push_back(Pair("bytes", n.nBytesSent));
+                obj.push_back(Pair("failures", n.nSendFailures));
+                obj.push_back(Pair("sendtimeavg", n.nMessagesSent ? n.nSendTimeTotal / (int64_t)n.nMessagesSent : 0));
+                obj.push_back(Pair("sendtimemax", n.nSendTimeMax));
+            }
+            result.push_back(obj);
+        }
+    }
+
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true  },
+};
+
+void RegisterZMQRPCCommands(CRPCTable& t)
+{
+    for (unsigned int vcidx = 0; vcidx < (sizeof(commands) / sizeof(commands[0])); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}